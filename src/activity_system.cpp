@@ -0,0 +1,103 @@
+#include "activity_system.hpp"
+#include "util/debug.hpp"
+#include <algorithm>
+
+ActivitySystem::ActivitySystem(entt::registry& reg) :
+    registry(reg)
+{
+}
+
+void ActivitySystem::step(float elapsed_ms) {
+    (void)elapsed_ms;
+    tick++;
+
+    auto players = registry.view<Player, Motion>();
+    if (players.begin() == players.end()) {
+        return;
+    }
+    vec2 player = registry.get<Motion>(players.front()).position;
+    vec2 camera = player;
+    auto cameras = registry.view<Camera>();
+    if (cameras.begin() != cameras.end()) {
+        camera = registry.get<Camera>(cameras.front()).offset;
+    }
+
+    refresh<Mob>(mobCursor, player, camera);
+    refresh<Projectile>(projectileCursor, player, camera);
+
+    for (auto&& [entity, lowFrequency] : registry.view<LowFrequency>().each()) {
+        lowFrequency.due = tick % LOW_FREQUENCY_TICKS == lowFrequency.phase;
+    }
+
+    debug_printf(DebugType::TIME, "ACTV: %zu low frequency, %zu asleep\n",
+        registry.storage<LowFrequency>().size(), registry.storage<Asleep>().size());
+}
+
+template<typename Tag>
+void ActivitySystem::refresh(size_t& cursor, vec2 player, vec2 camera) {
+    auto& storage = registry.storage<Tag>();
+    const size_t n = storage.size();
+    const size_t slice = (n + REFRESH_TICKS - 1) / REFRESH_TICKS;
+    // setLevel only touches the tag storages, so this one doesn't move under the cursor
+    for (size_t k = 0; k < slice; ++k, ++cursor) {
+        if (cursor >= n) {
+            cursor = 0;
+        }
+        entt::entity entity = storage.data()[cursor];
+        const Motion* motion = registry.try_get<Motion>(entity);
+        if (!motion) {
+            continue;
+        }
+        float distance = std::min(distanceOffScreen(motion->position, player), distanceOffScreen(motion->position, camera));
+        Level current = level(entity);
+        Level wanted = levelFor(distance);
+        if (wanted > current) {
+            wanted = std::max(current, levelFor(distance - HYSTERESIS));
+        }
+        if (wanted != current) {
+            setLevel(entity, wanted);
+        }
+    }
+}
+
+ActivitySystem::Level ActivitySystem::level(entt::entity entity) const {
+    if (registry.all_of<Asleep>(entity)) {
+        return Level::ASLEEP;
+    }
+    return registry.all_of<LowFrequency>(entity) ? Level::LOW_FREQUENCY : Level::ACTIVE;
+}
+
+void ActivitySystem::setLevel(entt::entity entity, Level level) {
+    registry.remove<LowFrequency>(entity);
+    if (auto* asleep = registry.try_get<Asleep>(entity)) {
+        if (asleep->dynamic) {
+            registry.emplace_or_replace<Dynamic>(entity);
+        }
+        registry.remove<Asleep>(entity);
+    }
+
+    if (level == Level::LOW_FREQUENCY) {
+        // spread over the cycle so a crowd leaving the screen together doesn't all run on the same tick
+        registry.emplace<LowFrequency>(entity, uint8_t(entt::to_entity(entity) % LOW_FREQUENCY_TICKS));
+    }
+    else if (level == Level::ASLEEP) {
+        registry.emplace<Asleep>(entity, registry.all_of<Dynamic>(entity));
+        registry.remove<Dynamic>(entity);
+        if (auto* motion = registry.try_get<Motion>(entity)) {
+            motion->formerPosition = motion->position; // nothing to sweep or interpolate while it sleeps
+        }
+    }
+}
+
+// how far outside a screen sized box around center the position is, 0 inside it
+float ActivitySystem::distanceOffScreen(vec2 position, vec2 center) {
+    vec2 outside = glm::max(glm::abs(position - center) - vec2(WINDOW_WIDTH_PX, WINDOW_HEIGHT_PX) / 2.f, vec2(0.f));
+    return std::max(outside.x, outside.y);
+}
+
+ActivitySystem::Level ActivitySystem::levelFor(float distance) {
+    if (distance <= ACTIVE_MARGIN) {
+        return Level::ACTIVE;
+    }
+    return distance <= LOW_FREQUENCY_MARGIN ? Level::LOW_FREQUENCY : Level::ASLEEP;
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include "common.hpp"
+#include <entt.hpp>
+#include <tinyECS/components.hpp>
+
+// Keeps things far from the player from costing anything. Mobs and projectiles are put in one of three levels by how
+// far they are outside the screen (around the player or the camera, whichever is closer):
+//  - active: no tag, everything runs every tick
+//  - low frequency (LowFrequency): AI and animation only run every LOW_FREQUENCY_TICKS ticks, with the time banked
+//  - asleep (Asleep): AI and animation skip them, and they lose their Dynamic tag so physics does too
+// Only a slice of them is re-checked each tick, so all of them are looked at every REFRESH_TICKS ticks; the active
+// margin is wide enough that nothing coming on screen is still asleep. Going to a sleepier level needs to be
+// HYSTERESIS further out, so things on a boundary don't flip every check.
+class ActivitySystem {
+public:
+    enum class Level { ACTIVE, LOW_FREQUENCY, ASLEEP }; // in order of sleepiness
+
+    static constexpr int LOW_FREQUENCY_TICKS = 6;
+    static constexpr int REFRESH_TICKS = 15;
+    static constexpr float ACTIVE_MARGIN = 256.f;        // px past the screen edge
+    static constexpr float LOW_FREQUENCY_MARGIN = 1024.f;
+    static constexpr float HYSTERESIS = 64.f;
+
+    ActivitySystem(entt::registry& reg);
+    void step(float elapsed_ms);
+
+    Level level(entt::entity entity) const;
+    void setLevel(entt::entity entity, Level level);
+private:
+    entt::registry& registry;
+    uint32_t tick = 0;
+    size_t mobCursor = 0;
+    size_t projectileCursor = 0;
+
+    template<typename Tag>
+    void refresh(size_t& cursor, vec2 player, vec2 camera);
+    static float distanceOffScreen(vec2 position, vec2 center);
+    static Level levelFor(float distance);
+};
@@ -0,0 +1,312 @@
+#include "cluster_graph.hpp"
+#include <algorithm>
+#include <functional>
+#include <climits>
+#include <cstdlib>
+#include <glm/common.hpp>
+
+namespace {
+// exact for the 10/14 moves with nothing in the way, so it never overestimates
+int32_t octile(ivec2 a, ivec2 b) {
+    int32_t dx = std::abs(a.x - b.x);
+    int32_t dy = std::abs(a.y - b.y);
+    return 10 * std::max(dx, dy) + 4 * std::min(dx, dy);
+}
+}
+
+int32_t ClusterGraph::clusterOf(ivec2 tile) const {
+    if (tile.x < 0 || tile.y < 0 || tile.x >= clustersX * CLUSTER_SIZE || tile.y >= clustersY * CLUSTER_SIZE) {
+        return -1;
+    }
+    return (tile.y / CLUSTER_SIZE) * clustersX + tile.x / CLUSTER_SIZE;
+}
+
+void ClusterGraph::build(const WalkabilityGrid& grid) {
+    clustersX = (grid.getWidth() + CLUSTER_SIZE - 1) / CLUSTER_SIZE;
+    clustersY = (grid.getHeight() + CLUSTER_SIZE - 1) / CLUSTER_SIZE;
+    size_t clusters = size_t(clustersX) * clustersY;
+    nodes.clear();
+    freeNodes.clear();
+    clusterNodes.assign(clusters, {});
+    eastBorder.assign(clusters, {});
+    southBorder.assign(clusters, {});
+    if (clusters > 0) {
+        rebuild(grid, ivec2(0), ivec2(grid.getWidth() - 1, grid.getHeight() - 1));
+    }
+}
+
+void ClusterGraph::rebuild(const WalkabilityGrid& grid, ivec2 lo, ivec2 hi) {
+    ivec2 maxCluster = ivec2(clustersX - 1, clustersY - 1);
+    ivec2 c0 = glm::clamp(glm::min(lo, hi) / CLUSTER_SIZE, ivec2(0), maxCluster);
+    ivec2 c1 = glm::clamp(glm::max(lo, hi) / CLUSTER_SIZE, ivec2(0), maxCluster);
+
+    // entrances on any border of the changed clusters
+    for (int cy = c0.y; cy <= c1.y; ++cy) {
+        for (int cx = std::max(c0.x - 1, 0); cx <= std::min(c1.x, clustersX - 2); ++cx) {
+            int32_t cluster = cy * clustersX + cx;
+            freeNodesOf(eastBorder[cluster]);
+            scanBorder(grid, cluster, true);
+        }
+    }
+    for (int cy = std::max(c0.y - 1, 0); cy <= std::min(c1.y, clustersY - 2); ++cy) {
+        for (int cx = c0.x; cx <= c1.x; ++cx) {
+            int32_t cluster = cy * clustersX + cx;
+            freeNodesOf(southBorder[cluster]);
+            scanBorder(grid, cluster, false);
+        }
+    }
+    // every cluster that had one of those borders
+    ivec2 l0 = glm::max(c0 - 1, ivec2(0));
+    ivec2 l1 = glm::min(c1 + 1, maxCluster);
+    for (int cy = l0.y; cy <= l1.y; ++cy) {
+        for (int cx = l0.x; cx <= l1.x; ++cx) {
+            linkCluster(grid, cy * clustersX + cx);
+        }
+    }
+}
+
+int32_t ClusterGraph::addNode(ivec2 tile, int32_t cluster) {
+    int32_t id;
+    if (!freeNodes.empty()) {
+        id = freeNodes.back();
+        freeNodes.pop_back();
+    }
+    else {
+        id = int32_t(nodes.size());
+        nodes.emplace_back();
+    }
+    nodes[id].tile = tile;
+    nodes[id].cluster = cluster;
+    clusterNodes[cluster].push_back(id);
+    return id;
+}
+
+void ClusterGraph::freeNodesOf(std::vector<int32_t>& border) {
+    for (int32_t id : border) {
+        AbstractNode& node = nodes[id];
+        auto& members = clusterNodes[node.cluster];
+        members.erase(std::remove(members.begin(), members.end(), id), members.end());
+        node.cluster = -1;
+        node.twin = -1;
+        node.edges.clear();
+        freeNodes.push_back(id);
+    }
+    border.clear();
+}
+
+void ClusterGraph::scanBorder(const WalkabilityGrid& grid, int32_t cluster, bool east) {
+    ivec2 origin = clusterOrigin(cluster);
+    // walk along the border: side is the last row/column of this cluster, across is one step into the next
+    ivec2 along = east ? ivec2(0, 1) : ivec2(1, 0);
+    ivec2 across = east ? ivec2(1, 0) : ivec2(0, 1);
+    ivec2 first = origin + across * (CLUSTER_SIZE - 1);
+    int length = east ? std::min(CLUSTER_SIZE, grid.getHeight() - origin.y) : std::min(CLUSTER_SIZE, grid.getWidth() - origin.x);
+    int32_t neighbour = cluster + (east ? 1 : clustersX);
+    auto& border = east ? eastBorder[cluster] : southBorder[cluster];
+
+    auto open = [&](int i) {
+        ivec2 side = first + along * i;
+        ivec2 other = side + across;
+        return grid.walkable(side.x, side.y) && grid.walkable(other.x, other.y);
+    };
+    auto addEntrance = [&](int i) {
+        ivec2 side = first + along * i;
+        int32_t a = addNode(side, cluster);
+        int32_t b = addNode(side + across, neighbour);
+        nodes[a].twin = b;
+        nodes[b].twin = a;
+        border.push_back(a);
+        border.push_back(b);
+    };
+    for (int i = 0; i < length; ) {
+        if (!open(i)) {
+            ++i;
+            continue;
+        }
+        int runStart = i;
+        while (i < length && open(i)) {
+            ++i;
+        }
+        int runEnd = i - 1;
+        if (runEnd - runStart + 1 >= LONG_ENTRANCE) {
+            addEntrance(runStart);
+            addEntrance(runEnd);
+        }
+        else {
+            addEntrance((runStart + runEnd) / 2);
+        }
+    }
+}
+
+void ClusterGraph::searchCluster(const WalkabilityGrid& grid, Scratch& scratch, int32_t cluster, ivec2 tile) const {
+    ivec2 origin = clusterOrigin(cluster);
+    ivec2 end = glm::min(origin + CLUSTER_SIZE, ivec2(grid.getWidth(), grid.getHeight()));
+    auto& localCost = scratch.localCost;
+    auto& localOpen = scratch.localOpen;
+    localCost.assign(CLUSTER_SIZE * CLUSTER_SIZE, -1);
+    localOpen.clear();
+
+    int32_t seed = localIndex(cluster, tile);
+    localCost[seed] = 0;
+    localOpen.emplace_back(0, seed);
+    while (!localOpen.empty()) {
+        std::pop_heap(localOpen.begin(), localOpen.end(), std::greater<>());
+        auto [cost, current] = localOpen.back();
+        localOpen.pop_back();
+        if (cost > localCost[current]) {
+            continue;
+        }
+        ivec2 at = origin + ivec2(current % CLUSTER_SIZE, current / CLUSTER_SIZE);
+        for (const auto& dir : PATH_DIRECTIONS) {
+            ivec2 neighbor = at + dir.offset;
+            if (neighbor.x < origin.x || neighbor.y < origin.y || neighbor.x >= end.x || neighbor.y >= end.y ||
+                !grid.walkable(neighbor.x, neighbor.y)) {
+                continue;
+            }
+            int32_t n = localIndex(cluster, neighbor);
+            int32_t tentative = cost + dir.cost;
+            if (localCost[n] < 0 || tentative < localCost[n]) {
+                localCost[n] = tentative;
+                localOpen.emplace_back(tentative, n);
+                std::push_heap(localOpen.begin(), localOpen.end(), std::greater<>());
+            }
+        }
+    }
+}
+
+void ClusterGraph::linkCluster(const WalkabilityGrid& grid, int32_t cluster) {
+    const auto& members = clusterNodes[cluster];
+    for (int32_t id : members) {
+        nodes[id].edges.clear();
+    }
+    for (int32_t id : members) {
+        searchCluster(grid, linking, cluster, nodes[id].tile);
+        for (int32_t other : members) {
+            int32_t cost = linking.localCost[localIndex(cluster, nodes[other].tile)];
+            if (other != id && cost >= 0) {
+                nodes[id].edges.push_back(Edge{ other, cost });
+            }
+        }
+    }
+}
+
+std::vector<ivec2> ClusterGraph::findPath(const WalkabilityGrid& grid, const JumpTable* jumps, PathfindingContext& context, Scratch& scratch, const ivec2& start, const ivec2& goal) const {
+    auto search = [&](const ivec2& from, const ivec2& to) {
+        return jumps ? context.findJumpPath(grid, *jumps, from, to, true) : context.findPath(grid, from, to, true);
+    };
+    int32_t startCluster = clusterOf(start);
+    int32_t goalCluster = clusterOf(goal);
+    if (startCluster < 0 || goalCluster < 0) {
+        return search(start, goal);
+    }
+    ivec2 apart = glm::abs(start / CLUSTER_SIZE - goal / CLUSTER_SIZE);
+    if (std::max(apart.x, apart.y) < 2) {
+        return search(start, goal);
+    }
+
+    // abstract A*: from start into the nodes of its cluster, over the graph, and out of the goal cluster's nodes
+    auto& nodeG = scratch.nodeG;
+    auto& nodeParent = scratch.nodeParent;
+    auto& nodeStamp = scratch.nodeStamp;
+    auto& goalCost = scratch.goalCost;
+    auto& open = scratch.open;
+    using OpenNode = Scratch::OpenNode;
+    // mobs chasing the same thing ask for the same goal one after another, that side is only searched once
+    const bool sameGoal = scratch.goalKnown && scratch.goal == goal;
+    if (!sameGoal) {
+        for (auto [id, cost] : scratch.goalCosts) {
+            goalCost[id] = -1;
+        }
+        scratch.goalCosts.clear();
+    }
+    nodeG.resize(nodes.size());
+    nodeParent.resize(nodes.size());
+    nodeStamp.resize(nodes.size(), 0);
+    goalCost.resize(nodes.size(), -1);
+    if (++scratch.generation == 0) {
+        std::fill(nodeStamp.begin(), nodeStamp.end(), 0);
+        scratch.generation = 1;
+    }
+    const uint32_t generation = scratch.generation;
+    open.clear();
+    auto later = [](const OpenNode& a, const OpenNode& b) { return a.f > b.f; };
+    auto push = [&](int32_t node, int32_t g, int32_t parent) {
+        if (nodeStamp[node] == generation && nodeG[node] <= g) {
+            return;
+        }
+        nodeStamp[node] = generation;
+        nodeG[node] = g;
+        nodeParent[node] = parent;
+        open.push_back(OpenNode{ g + octile(nodes[node].tile, goal), node });
+        std::push_heap(open.begin(), open.end(), later);
+    };
+
+    if (!sameGoal) {
+        searchCluster(grid, scratch, goalCluster, goal);
+        for (int32_t id : clusterNodes[goalCluster]) {
+            int32_t cost = scratch.localCost[localIndex(goalCluster, nodes[id].tile)];
+            goalCost[id] = cost;
+            scratch.goalCosts.emplace_back(id, cost);
+        }
+        scratch.goalKnown = true;
+        scratch.goal = goal;
+    }
+    searchCluster(grid, scratch, startCluster, start);
+    for (int32_t id : clusterNodes[startCluster]) {
+        int32_t cost = scratch.localCost[localIndex(startCluster, nodes[id].tile)];
+        if (cost >= 0) {
+            push(id, cost, -1);
+        }
+    }
+
+    int32_t bestEnd = -1;
+    int32_t bestCost = INT_MAX;
+    while (!open.empty()) {
+        std::pop_heap(open.begin(), open.end(), later);
+        OpenNode current = open.back();
+        open.pop_back();
+        if (current.f >= bestCost) {
+            break;
+        }
+        int32_t g = nodeG[current.node];
+        if (current.f != g + octile(nodes[current.node].tile, goal)) {
+            continue; // a cheaper way here was found since
+        }
+        if (goalCost[current.node] >= 0 && g + goalCost[current.node] < bestCost) {
+            bestCost = g + goalCost[current.node];
+            bestEnd = current.node;
+        }
+        const AbstractNode& node = nodes[current.node];
+        push(node.twin, g + 10, current.node);
+        for (const Edge& edge : node.edges) {
+            push(edge.to, g + edge.cost, current.node);
+        }
+    }
+    if (bestEnd < 0) {
+        return search(start, goal);
+    }
+
+    std::vector<ivec2> waypoints;
+    waypoints.push_back(goal);
+    for (int32_t node = bestEnd; node >= 0; node = nodeParent[node]) {
+        waypoints.push_back(nodes[node].tile);
+    }
+    waypoints.push_back(start);
+    std::reverse(waypoints.begin(), waypoints.end());
+
+    // refine into tiles until REFINE_CLUSTERS clusters have been crossed; stepping over an entrance doesn't count
+    std::vector<ivec2> path;
+    path.push_back(start);
+    int refined = 0;
+    for (size_t i = 0; i + 1 < waypoints.size() && refined < REFINE_CLUSTERS; ++i) {
+        std::vector<ivec2> segment = search(waypoints[i], waypoints[i + 1]);
+        path.insert(path.end(), segment.begin() + 1, segment.end());
+        if (segment.back() != waypoints[i + 1]) {
+            break;
+        }
+        if (clusterOf(waypoints[i]) == clusterOf(waypoints[i + 1])) {
+            refined++;
+        }
+    }
+    return path;
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <utility>
+#include "path_finder.hpp"
+
+// HPA*: the map is cut into CLUSTER_SIZE x CLUSTER_SIZE clusters. Where two neighbouring clusters share a run of
+// walkable tiles on both sides of their border there is an entrance (one in the middle of short runs, one at each end
+// of long ones), made of a node on either side. Nodes of the same cluster are linked with the cost of walking between
+// them inside the cluster, worked out once when the map is loaded.
+// A long search only runs A* over these nodes and then refines the first few clusters of the result into tiles;
+// by the time a mob walks off the refined part it asks again. rebuild() redoes just the clusters around changed tiles.
+class ClusterGraph {
+public:
+    static constexpr int CLUSTER_SIZE = 16;
+    static constexpr int LONG_ENTRANCE = 6; // runs at least this long get an entrance at each end
+    static constexpr int REFINE_CLUSTERS = 3;
+
+    void build(const WalkabilityGrid& grid);
+    // the tiles in [lo, hi] changed in grid
+    void rebuild(const WalkabilityGrid& grid, ivec2 lo, ivec2 hi);
+
+    // What one search over the graph needs besides the graph, so a built graph can be searched from several threads
+    // with one Scratch each. Costs into the last goal's cluster are kept for the next search to the same goal.
+    class Scratch {
+    public:
+        // the graph changed or a different one is searched next
+        void forgetGoal() { goalKnown = false; }
+    private:
+        friend class ClusterGraph;
+        std::vector<int32_t> localCost;
+        std::vector<std::pair<int32_t, int32_t>> localOpen; // (cost, local index) min-heap
+        std::vector<int32_t> nodeG;
+        std::vector<int32_t> nodeParent;
+        std::vector<uint32_t> nodeStamp;
+        uint32_t generation = 0;
+        struct OpenNode {
+            int32_t f;
+            int32_t node;
+        };
+        std::vector<OpenNode> open;
+        bool goalKnown = false;
+        ivec2 goal = ivec2(0);
+        std::vector<std::pair<int32_t, int32_t>> goalCosts; // (node of the goal's cluster, cost from it on to the goal)
+        std::vector<int32_t> goalCost; // the same by node, -1 for the rest
+    };
+
+    // Tiles from start to goal like PathfindingContext::findPath. Starts and goals less than two clusters apart are
+    // searched directly; further ones come back refined up to REFINE_CLUSTERS clusters in, ending on an entrance.
+    // Falls back to the capped direct search if the graph doesn't connect them. The direct and refining searches are
+    // jump point searches when jumps is given, A* otherwise.
+    std::vector<ivec2> findPath(const WalkabilityGrid& grid, const JumpTable* jumps, PathfindingContext& context, Scratch& scratch, const ivec2& start, const ivec2& goal) const;
+
+    size_t nodeCount() const { return nodes.size() - freeNodes.size(); }
+private:
+    struct Edge {
+        int32_t to;
+        int32_t cost;
+    };
+    struct AbstractNode {
+        ivec2 tile;
+        int32_t cluster = -1; // -1 once freed
+        int32_t twin = -1;    // the node on the other side of its entrance, one step away
+        std::vector<Edge> edges; // to nodes of the same cluster
+    };
+
+    int clustersX = 0, clustersY = 0;
+    std::vector<AbstractNode> nodes;
+    std::vector<int32_t> freeNodes;
+    std::vector<std::vector<int32_t>> clusterNodes;
+    // nodes of the entrances on the east and south border of each cluster
+    std::vector<std::vector<int32_t>> eastBorder, southBorder;
+
+    Scratch linking; // for the searches inside clusters while building
+
+    int32_t clusterOf(ivec2 tile) const;
+    ivec2 clusterOrigin(int32_t cluster) const {
+        return ivec2(cluster % clustersX, cluster / clustersX) * CLUSTER_SIZE;
+    }
+    int32_t addNode(ivec2 tile, int32_t cluster);
+    void freeNodesOf(std::vector<int32_t>& border);
+    void scanBorder(const WalkabilityGrid& grid, int32_t cluster, bool east);
+    void linkCluster(const WalkabilityGrid& grid, int32_t cluster);
+    // walking costs from tile to every tile of cluster, into scratch.localCost (-1 where it can't get to)
+    void searchCluster(const WalkabilityGrid& grid, Scratch& scratch, int32_t cluster, ivec2 tile) const;
+    int32_t localIndex(int32_t cluster, ivec2 tile) const {
+        ivec2 local = tile - clusterOrigin(cluster);
+        return local.y * CLUSTER_SIZE + local.x;
+    }
+};
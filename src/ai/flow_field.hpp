@@ -0,0 +1,51 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include "path_finder.hpp"
+
+// Distances to the player's tile for every tile around the player, shared by all the chasing mobs so they don't each
+// run an A* to the same goal. Dijkstra from the player's tile with the same moves and costs as Pathfinder, over a
+// (2 * RADIUS + 1)^2 window of tiles, and not further than RADIUS tiles of walking.
+// track() is given the player's tile every AI tick and only marks the field stale when it changed; the field is rebuilt
+// on the first query after that, so it costs nothing while nobody is chasing. The window's walkability is only copied
+// from the map again when the player gets near its edge. Goals other than the player still go through Pathfinder.
+class FlowField {
+public:
+    static constexpr int RADIUS = 56; // tiles, a bit past the longest unchase range
+
+    static FlowField& getInstance();
+
+    void track(ivec2 goalTile);
+    // the neighbour of tile to step to next, false if tile is the goal or the field doesn't reach it
+    bool next(ivec2 tile, ivec2& step);
+    ivec2 goal() const { return target; }
+    // the tiles in [lo, hi] changed (Pathfinder::tilesChanged calls this once its new map is current): re-reads the
+    // part of the window they cover and rebuilds on the next query
+    void tilesChanged(ivec2 lo, ivec2 hi);
+    // a whole new map was loaded, the window is read again on the next track()
+    void reset();
+private:
+    static constexpr int SIZE = 2 * RADIUS + 1;
+    static constexpr int32_t MAX_COST = RADIUS * 10;
+
+    ivec2 target = ivec2(-1);
+    ivec2 origin = ivec2(0); // tile of cell 0
+    bool tracking = false;
+    bool stale = true;
+    bool windowValid = false;
+
+    std::vector<uint8_t> walkable; // per cell
+    std::vector<int32_t> dist;
+    std::vector<uint32_t> stamp;   // dist of a cell is only set if its stamp is the current generation
+    uint32_t generation = 0;
+    std::vector<std::vector<int32_t>> buckets; // cells to expand by cost
+
+    bool inWindow(ivec2 tile) const {
+        ivec2 local = tile - origin;
+        return local.x >= 0 && local.y >= 0 && local.x < SIZE && local.y < SIZE;
+    }
+    int32_t cell(ivec2 tile) const { return (tile.y - origin.y) * SIZE + (tile.x - origin.x); }
+    void recenter();
+    void rebuild();
+};
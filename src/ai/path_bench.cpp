@@ -0,0 +1,167 @@
+#include "path_bench.hpp"
+#include "path_finder.hpp"
+#include <map/map_system.hpp>
+#include <util/priority_queue.hpp>
+#include <unordered_map>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <cstdio>
+
+namespace {
+using BenchClock = std::chrono::steady_clock;
+
+// Pathfinder::findPath as it was before the flat arrays, kept as the reference the benchmark compares against
+std::vector<ivec2> referenceFindPath(const ivec2& start, const ivec2& goal, bool limitIterations) {
+    auto heuristic = [](const ivec2& a, const ivec2& b) -> int {
+        return glm::distance((vec2) a,  (vec2) b) * 10.0f;
+    };
+    std::vector<ivec2> path;
+    PriorityQueue<Node, int> openSet;
+    std::unordered_map<ivec2, ivec2, IVec2Hash> cameFrom;
+    std::unordered_map<ivec2, int, IVec2Hash> gScore;
+    gScore[start] = 0;
+    std::unordered_map<ivec2, int, IVec2Hash> fScore;
+    fScore[start] = heuristic(start, goal);
+    openSet.put(Node(start, start, 0, fScore[start]), fScore[start]);
+
+    int iterations = 0;
+    const int maxIterations = 10000;
+    Node bestNode(start, start, 0, fScore[start]);
+    int bestScore = fScore[start];
+
+    while (!openSet.empty() && (!limitIterations || iterations < maxIterations)) {
+        iterations++;
+        Node current = openSet.get();
+        if (current.position == goal) {
+            bestNode = current;
+            break;
+        }
+        if (current.getScore() < bestScore) {
+            bestScore = current.getScore();
+            bestNode = current;
+        }
+        for (const auto& dir : PATH_DIRECTIONS) {
+            ivec2 neighbor = current.position + dir.offset;
+            if (neighbor.x < 0 || neighbor.x >= MapSystem::map_width ||
+                neighbor.y < 0 || neighbor.y >= MapSystem::map_height)
+                continue;
+            if (!MapSystem::walkable_tile(MapSystem::get_tile_type_by_indices(neighbor.x, neighbor.y)))
+                continue;
+            int tentativeG = current.G + dir.cost;
+            if (gScore.find(neighbor) == gScore.end() || tentativeG < gScore[neighbor]) {
+                cameFrom[neighbor] = current.position;
+                gScore[neighbor] = tentativeG;
+                float h = heuristic(neighbor, goal);
+                float f = tentativeG + h;
+                fScore[neighbor] = f;
+                openSet.put(Node(neighbor, current.position, tentativeG, h), f);
+            }
+        }
+    }
+
+    ivec2 curPos = bestNode.position;
+    while (curPos != start) {
+        path.push_back(curPos);
+        curPos = cameFrom[curPos];
+    }
+    path.push_back(start);
+    std::reverse(path.begin(), path.end());
+    return path;
+}
+
+double msSince(BenchClock::time_point start) {
+    return std::chrono::duration<double, std::milli>(BenchClock::now() - start).count();
+}
+
+// walking cost of a path, -1 if it isn't one (a jump that isn't a single move, or onto a tile that can't be walked)
+int pathCost(const WalkabilityGrid& grid, const std::vector<ivec2>& path) {
+    int cost = 0;
+    for (size_t i = 1; i < path.size(); ++i) {
+        ivec2 step = glm::abs(path[i] - path[i - 1]);
+        if (std::max(step.x, step.y) != 1 || !grid.walkable(path[i].x, path[i].y)) {
+            return -1;
+        }
+        cost += step.x != 0 && step.y != 0 ? 14 : 10;
+    }
+    return cost;
+}
+}
+
+void runPathBenchmark(int queries, unsigned seed) {
+    const WalkabilityGrid& grid = Pathfinder::grid();
+    if (grid.getWidth() <= 0 || grid.getHeight() <= 0) {
+        std::printf("path bench: no map loaded\n");
+        return;
+    }
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<int> xs(0, grid.getWidth() - 1), ys(0, grid.getHeight() - 1), near(-40, 40);
+    auto randomWalkable = [&](ivec2 around, bool local) {
+        for (int attempt = 0; attempt < 1000; ++attempt) {
+            ivec2 tile = local ? around + ivec2(near(rng), near(rng)) : ivec2(xs(rng), ys(rng));
+            if (grid.walkable(tile.x, tile.y)) {
+                return tile;
+            }
+        }
+        return around;
+    };
+
+    PathfindingContext context;
+    int identical = 0;
+    size_t expansions = 0, jumpExpansions = 0;
+    double referenceMs = 0.0, flatMs = 0.0, jumpMs = 0.0;
+    int jumpSame = 0, jumpCheaper = 0, jumpDearer = 0, jumpInvalid = 0;
+    for (int q = 0; q < queries; ++q) {
+        bool local = q % 2 == 0;
+        ivec2 start = randomWalkable(ivec2(0), false);
+        ivec2 goal = randomWalkable(start, local);
+        bool limit = !local;
+
+        auto t0 = BenchClock::now();
+        std::vector<ivec2> reference = referenceFindPath(start, goal, limit);
+        referenceMs += msSince(t0);
+
+        auto t1 = BenchClock::now();
+        std::vector<ivec2> flat = context.findPath(grid, start, goal, limit);
+        flatMs += msSince(t1);
+        expansions += context.lastExpansions();
+
+        if (reference == flat) {
+            identical++;
+        }
+        else {
+            std::printf("path bench: paths differ from (%d, %d) to (%d, %d)\n", start.x, start.y, goal.x, goal.y);
+        }
+
+        auto t2 = BenchClock::now();
+        std::vector<ivec2> jump = context.findJumpPath(grid, Pathfinder::jumpTable(), start, goal, limit);
+        jumpMs += msSince(t2);
+        jumpExpansions += context.lastExpansions();
+
+        // both can stop short of the goal (capped, or no way there), only complete paths are compared
+        int flatCost = pathCost(grid, flat);
+        int jumpCost = pathCost(grid, jump);
+        if (jumpCost < 0) {
+            jumpInvalid++;
+        }
+        else if (flat.back() == goal && jump.back() == goal) {
+            if (jumpCost < flatCost) {
+                jumpCheaper++;
+            }
+            else if (jumpCost > flatCost) {
+                jumpDearer++;
+            }
+            else {
+                jumpSame++;
+            }
+        }
+    }
+
+    std::printf("path bench: %d queries on a %dx%d map, %d identical paths\n", queries, grid.getWidth(), grid.getHeight(), identical);
+    std::printf("path bench: reference A* %.3f ms/query, flat A* %.3f ms/query, %.1f expansions/query\n",
+        referenceMs / std::max(queries, 1), flatMs / std::max(queries, 1), double(expansions) / std::max(queries, 1));
+    std::printf("path bench: jump point search %.3f ms/query, %.1f expansions/query\n",
+        jumpMs / std::max(queries, 1), double(jumpExpansions) / std::max(queries, 1));
+    std::printf("path bench: jump point path cost vs flat A*: %d same, %d cheaper, %d dearer, %d invalid\n",
+        jumpSame, jumpCheaper, jumpDearer, jumpInvalid);
+}
@@ -0,0 +1,7 @@
+#pragma once
+
+// Runs random start/goal pairs on the loaded map through Pathfinder and through the original map based A* it
+// replaced, checks they find the same paths and prints the timings. Started with --path-bench N from main.
+// Half the pairs are within chase distance of each other, the rest anywhere on the map (with the iteration cap).
+// The same pairs also go through jump point search, which is timed and has its path costs compared to A*'s.
+void runPathBenchmark(int queries, unsigned seed);
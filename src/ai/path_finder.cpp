@@ -1,10 +1,10 @@
 #include "path_finder.hpp"
-#include <util/priority_queue.hpp>
+#include "path_map.hpp"
+#include "flow_field.hpp"
 #include <map/map_system.hpp>
-#include <unordered_map>
-#include <unordered_set>
 #include <cmath>
 #include <algorithm>
+#include <glm/common.hpp>
 
 static inline int heuristic(const ivec2& a, const ivec2& b) {
     // return std::abs(a.x - b.x) + std::abs(a.y - b.y);
@@ -15,92 +15,371 @@ static inline int heuristic(const ivec2& a, const ivec2& b) {
     return glm::distance((vec2) a,  (vec2) b) * 10.0f; // to match the dir cost
 }
 
-std::vector<ivec2> Pathfinder::findPath(const ivec2& start, const ivec2& goal, bool limitIterations) {
+void WalkabilityGrid::build() {
+    width = std::max(0, MapSystem::map_width);
+    height = std::max(0, MapSystem::map_height);
+    wordsPerRow = (size_t(width) + 63) / 64;
+    bits.assign(wordsPerRow * height, 0);
+    refresh(ivec2(0), ivec2(width - 1, height - 1));
+}
+
+void WalkabilityGrid::refresh(ivec2 lo, ivec2 hi) {
+    lo = glm::max(lo, ivec2(0));
+    hi = glm::min(hi, ivec2(width - 1, height - 1));
+    for (int y = lo.y; y <= hi.y; ++y) {
+        for (int x = lo.x; x <= hi.x; ++x) {
+            uint64_t bit = uint64_t(1) << (x % 64);
+            uint64_t& word = bits[size_t(y) * wordsPerRow + size_t(x) / 64];
+            if (MapSystem::walkable_tile(MapSystem::get_tile_type_by_indices(x, y))) {
+                word |= bit;
+            }
+            else {
+                word &= ~bit;
+            }
+        }
+    }
+}
+
+namespace {
+int octile(ivec2 a, ivec2 b) {
+    int dx = std::abs(a.x - b.x);
+    int dy = std::abs(a.y - b.y);
+    return 10 * std::max(dx, dy) + 4 * std::min(dx, dy);
+}
+
+int directionIndex(ivec2 offset) {
+    for (int dir = 0; dir < int(PATH_DIRECTIONS.size()); ++dir) {
+        if (PATH_DIRECTIONS[dir].offset == offset) {
+            return dir;
+        }
+    }
+    return -1;
+}
+
+bool isDiagonal(ivec2 offset) {
+    return offset.x != 0 && offset.y != 0;
+}
+
+// A tile entered going straight along d has a forced neighbour if a side of it is blocked but the tile ahead of
+// that side isn't: nothing but a path through this tile gets there as cheaply.
+bool forcedStraight(const WalkabilityGrid& grid, ivec2 at, ivec2 d) {
+    ivec2 side(d.y, d.x);
+    return (!grid.walkable(at.x + side.x, at.y + side.y) && grid.walkable(at.x + d.x + side.x, at.y + d.y + side.y)) ||
+        (!grid.walkable(at.x - side.x, at.y - side.y) && grid.walkable(at.x + d.x - side.x, at.y + d.y - side.y));
+}
+
+bool forcedDiagonal(const WalkabilityGrid& grid, ivec2 at, ivec2 d) {
+    return (!grid.walkable(at.x - d.x, at.y) && grid.walkable(at.x - d.x, at.y + d.y)) ||
+        (!grid.walkable(at.x, at.y - d.y) && grid.walkable(at.x + d.x, at.y - d.y));
+}
+}
+
+void JumpTable::build(const WalkabilityGrid& grid) {
+    width = grid.getWidth();
+    height = grid.getHeight();
+    jumps.assign(size_t(width) * height * 8, 0);
+
+    // every entry depends on the one a step further along its direction, so sweep from the far end; straights
+    // first since a diagonal stops wherever one of its straights would find a jump point
+    for (int dir = 0; dir < int(PATH_DIRECTIONS.size()); ++dir) {
+        ivec2 d = PATH_DIRECTIONS[dir].offset;
+        int alongX = directionIndex(ivec2(d.x, 0));
+        int alongY = directionIndex(ivec2(0, d.y));
+        for (int j = 0; j < height; ++j) {
+            int y = d.y > 0 ? height - 1 - j : j;
+            for (int i = 0; i < width; ++i) {
+                int x = d.x > 0 ? width - 1 - i : i;
+                ivec2 next(x + d.x, y + d.y);
+                int16_t& entry = jumps[(size_t(y) * width + x) * 8 + dir];
+                if (!grid.walkable(next.x, next.y)) {
+                    entry = 0;
+                    continue;
+                }
+                bool jumpPoint = isDiagonal(d)
+                    ? forcedDiagonal(grid, next, d) || distance(next.x, next.y, alongX) > 0 || distance(next.x, next.y, alongY) > 0
+                    : forcedStraight(grid, next, d);
+                int further = distance(next.x, next.y, dir);
+                entry = jumpPoint ? 1 : further > 0 ? further + 1 : further - 1;
+            }
+        }
+    }
+}
+
+void PathfindingContext::reset(const WalkabilityGrid& grid) {
+    if (grid.getWidth() != width || grid.getHeight() != height) {
+        width = grid.getWidth();
+        height = grid.getHeight();
+        size_t tiles = size_t(width) * height;
+        stamp.assign(tiles, 0);
+        gScore.resize(tiles);
+        cameFrom.resize(tiles);
+        generation = 0;
+    }
+    if (++generation == 0) {
+        std::fill(stamp.begin(), stamp.end(), 0);
+        generation = 1;
+    }
+    open.clear();
+    expansions = 0;
+}
+
+std::vector<ivec2> PathfindingContext::findPath(const WalkabilityGrid& grid, const ivec2& start, const ivec2& goal, bool limitIterations) {
+    reset(grid);
     std::vector<ivec2> path;
-    
-    PriorityQueue<Node, int> openSet;
-    
-    std::unordered_map<ivec2, ivec2, IVec2Hash> cameFrom;
-    
-    std::unordered_map<ivec2, int, IVec2Hash> gScore;
-    gScore[start] = 0;
-    
-    std::unordered_map<ivec2, int, IVec2Hash> fScore;
-    fScore[start] = heuristic(start, goal);
-    
-    openSet.put(Node(start, start, 0, fScore[start]), fScore[start]);
-    
-    const std::vector<Direction> directions = {
-        { ivec2(0, -1), 10 },   // up
-        { ivec2(1, 0), 10 },    // right
-        { ivec2(0, 1), 10 },    // down
-        { ivec2(-1, 0), 10 },   // left
-        { ivec2(1, -1), 14 },   // up-right
-        { ivec2(1, 1), 14 },    // down-right
-        { ivec2(-1, 1), 14 },   // down-left
-        { ivec2(-1, -1), 14 }   // up-left
-    };
+
+    // the start can be off the map (nothing is stored for it then), every other node is on a walkable tile
+    auto cellOf = [this](const ivec2& tile) { return int32_t(tile.y) * width + tile.x; };
+    const bool startOnMap = start.x >= 0 && start.y >= 0 && start.x < width && start.y < height;
+    if (startOnMap) {
+        int32_t cell = cellOf(start);
+        stamp[cell] = generation;
+        gScore[cell] = 0;
+    }
+
+    const int startF = heuristic(start, goal);
+    open.push_back(OpenNode{ startF, 0, start });
 
     int iterations = 0;
     const int maxIterations = 10000;
 
-    Node bestNode(start, start, 0, fScore[start]);
-    int bestScore = fScore[start];
-    
-    while (!openSet.empty() && (!limitIterations || iterations < maxIterations)) {
+    ivec2 bestNode = start;
+    int bestScore = startF;
+
+    auto reconstruct = [&](ivec2 curPos) {
+        while (curPos != start) {
+            path.push_back(curPos);
+            curPos = cameFrom[cellOf(curPos)];
+        }
+        path.push_back(start);
+        std::reverse(path.begin(), path.end());
+    };
+
+    while (!open.empty() && (!limitIterations || iterations < maxIterations)) {
         iterations++;
-        Node current = openSet.get();
-        
+        std::pop_heap(open.begin(), open.end(), Later());
+        OpenNode current = open.back();
+        open.pop_back();
+        expansions++;
+
         if (current.position == goal) {
-            // Reconstruct path.
-            ivec2 curPos = current.position;
-            while (curPos != start) {
-                path.push_back(curPos);
-                curPos = cameFrom[curPos];
-            }
-            path.push_back(start);
-            std::reverse(path.begin(), path.end());
+            reconstruct(current.position);
             return path;
         }
 
         // Update the best node if current has a lower f-score.
-        if (current.getScore() < bestScore) {
-            bestScore = current.getScore();
-            bestNode = current;
+        if (current.f < bestScore) {
+            bestScore = current.f;
+            bestNode = current.position;
         }
-        
-        // For each neighbor.
-        for (const auto& dir : directions) {
+
+        for (const auto& dir : PATH_DIRECTIONS) {
             ivec2 neighbor = current.position + dir.offset;
-            // Check bounds using MapSystem.
-            if (neighbor.x < 0 || neighbor.x >= MapSystem::map_width ||
-                neighbor.y < 0 || neighbor.y >= MapSystem::map_height)
-                continue;
-            
-            // Check if neighbor tile is walkable.
-            if (!MapSystem::walkable_tile(MapSystem::get_tile_type_by_indices(neighbor.x, neighbor.y)))
+            // off the map isn't walkable either
+            if (!grid.walkable(neighbor.x, neighbor.y)) {
                 continue;
-            
-            int tentativeG = current.G + dir.cost; // Assuming cost 1 for each move.
-            if (gScore.find(neighbor) == gScore.end() || tentativeG < gScore[neighbor]) {
-                cameFrom[neighbor] = current.position;
-                gScore[neighbor] = tentativeG;
-                float h = heuristic(neighbor, goal);
-                float f = tentativeG + h;
-                fScore[neighbor] = f;
-                openSet.put(Node(neighbor, current.position, tentativeG, h), f);
+            }
+
+            int32_t cell = cellOf(neighbor);
+            int tentativeG = current.G + dir.cost;
+            if (!seen(cell) || tentativeG < gScore[cell]) {
+                stamp[cell] = generation;
+                cameFrom[cell] = current.position;
+                gScore[cell] = tentativeG;
+                int f = tentativeG + heuristic(neighbor, goal);
+                open.push_back(OpenNode{ f, tentativeG, neighbor });
+                std::push_heap(open.begin(), open.end(), Later());
             }
         }
     }
-    
+
     // we exceeded maxIterations or no path found
     // Reconstruct path from the best node encountered
-    ivec2 curPos = bestNode.position;
-    while (curPos != start) {
-        path.push_back(curPos);
-        curPos = cameFrom[curPos];
+    reconstruct(bestNode);
+    return path;
+}
+
+std::vector<ivec2> PathfindingContext::findJumpPath(const WalkabilityGrid& grid, const JumpTable& jumps, const ivec2& start, const ivec2& goal, bool limitIterations) {
+    const bool startOnMap = start.x >= 0 && start.y >= 0 && start.x < grid.getWidth() && start.y < grid.getHeight();
+    if (!startOnMap) {
+        return findPath(grid, start, goal, limitIterations);
+    }
+    reset(grid);
+    std::vector<ivec2> path;
+
+    auto cellOf = [this](const ivec2& tile) { return int32_t(tile.y) * width + tile.x; };
+    stamp[cellOf(start)] = generation;
+    gScore[cellOf(start)] = 0;
+    cameFrom[cellOf(start)] = start;
+
+    const int startF = octile(start, goal);
+    open.push_back(OpenNode{ startF, 0, start });
+
+    int iterations = 0;
+    const int maxIterations = 10000;
+
+    ivec2 bestNode = start;
+    int bestScore = startF;
+
+    // jump points are joined by straight or diagonal runs, fill those in
+    auto reconstruct = [&](ivec2 curPos) {
+        while (curPos != start) {
+            ivec2 parent = cameFrom[cellOf(curPos)];
+            ivec2 step = glm::sign(parent - curPos);
+            for (ivec2 tile = curPos; tile != parent; tile += step) {
+                path.push_back(tile);
+            }
+            curPos = parent;
+        }
+        path.push_back(start);
+        std::reverse(path.begin(), path.end());
+    };
+
+    auto tryDirection = [&](const OpenNode& current, int dir) {
+        ivec2 d = PATH_DIRECTIONS[dir].offset;
+        ivec2 toGoal = goal - current.position;
+        int distance = jumps.distance(current.position.x, current.position.y, dir);
+        int reach = std::abs(distance);
+        int steps = 0;
+        if (isDiagonal(d)) {
+            // the goal is somewhere ahead in this quadrant: stop level with it, the straights take it from there
+            if (glm::sign(toGoal) == d) {
+                int level = std::min(std::abs(toGoal.x), std::abs(toGoal.y));
+                steps = level <= reach ? level : 0;
+            }
+        }
+        else if ((d.x == 0 ? toGoal.x == 0 && glm::sign(toGoal.y) == d.y : toGoal.y == 0 && glm::sign(toGoal.x) == d.x)) {
+            int ahead = std::abs(toGoal.x) + std::abs(toGoal.y);
+            steps = ahead <= reach ? ahead : 0;
+        }
+        if (steps == 0 && distance > 0) {
+            steps = distance;
+        }
+        if (steps == 0) {
+            return;
+        }
+
+        ivec2 neighbor = current.position + d * steps;
+        int32_t cell = cellOf(neighbor);
+        int tentativeG = current.G + PATH_DIRECTIONS[dir].cost * steps;
+        if (!seen(cell) || tentativeG < gScore[cell]) {
+            stamp[cell] = generation;
+            cameFrom[cell] = current.position;
+            gScore[cell] = tentativeG;
+            open.push_back(OpenNode{ tentativeG + octile(neighbor, goal), tentativeG, neighbor });
+            std::push_heap(open.begin(), open.end(), Later());
+        }
+    };
+
+    while (!open.empty() && (!limitIterations || iterations < maxIterations)) {
+        std::pop_heap(open.begin(), open.end(), Later());
+        OpenNode current = open.back();
+        open.pop_back();
+        if (current.G > gScore[cellOf(current.position)]) {
+            continue; // already expanded on a cheaper way
+        }
+        iterations++;
+        expansions++;
+
+        if (current.position == goal) {
+            reconstruct(current.position);
+            return path;
+        }
+        if (current.f < bestScore) {
+            bestScore = current.f;
+            bestNode = current.position;
+        }
+
+        // the start looks every way; otherwise keep going the way we came plus wherever a forced neighbour opens up
+        ivec2 parent = cameFrom[cellOf(current.position)];
+        if (parent == current.position) {
+            for (int dir = 0; dir < int(PATH_DIRECTIONS.size()); ++dir) {
+                tryDirection(current, dir);
+            }
+            continue;
+        }
+        ivec2 d = glm::sign(current.position - parent);
+        ivec2 at = current.position;
+        if (isDiagonal(d)) {
+            tryDirection(current, directionIndex(ivec2(d.x, 0)));
+            tryDirection(current, directionIndex(ivec2(0, d.y)));
+            tryDirection(current, directionIndex(d));
+            if (!grid.walkable(at.x - d.x, at.y)) {
+                tryDirection(current, directionIndex(ivec2(-d.x, d.y)));
+            }
+            if (!grid.walkable(at.x, at.y - d.y)) {
+                tryDirection(current, directionIndex(ivec2(d.x, -d.y)));
+            }
+        }
+        else {
+            ivec2 side(d.y, d.x);
+            tryDirection(current, directionIndex(d));
+            if (!grid.walkable(at.x + side.x, at.y + side.y)) {
+                tryDirection(current, directionIndex(d + side));
+            }
+            if (!grid.walkable(at.x - side.x, at.y - side.y)) {
+                tryDirection(current, directionIndex(d - side));
+            }
+        }
     }
-    path.push_back(start);
-    std::reverse(path.begin(), path.end());
+
+    reconstruct(bestNode);
     return path;
-}
\ No newline at end of file
+}
+
+// for the searches on the main thread
+static PathWorkspace& mainWorkspace() {
+    static PathWorkspace workspace;
+    return workspace;
+}
+
+std::vector<ivec2> Pathfinder::findPath(const ivec2& start, const ivec2& goal, bool limitIterations) {
+    return findPath(*current, mainWorkspace(), start, goal, limitIterations);
+}
+
+std::vector<ivec2> Pathfinder::findLongPath(const ivec2& start, const ivec2& goal) {
+    return findLongPath(*current, mainWorkspace(), start, goal);
+}
+
+std::vector<ivec2> Pathfinder::findPath(const PathMap& map, PathWorkspace& workspace, const ivec2& start, const ivec2& goal, bool limitIterations) {
+    if (mode == PathMode::JUMP_POINT) {
+        return workspace.context.findJumpPath(map.walkability, map.jumps, start, goal, limitIterations);
+    }
+    return workspace.context.findPath(map.walkability, start, goal, limitIterations);
+}
+
+std::vector<ivec2> Pathfinder::findLongPath(const PathMap& map, PathWorkspace& workspace, const ivec2& start, const ivec2& goal) {
+    const JumpTable* jumps = mode == PathMode::JUMP_POINT ? &map.jumps : nullptr;
+    return map.clusters.findPath(map.walkability, jumps, workspace.context, workspace.clusters, start, goal);
+}
+
+void Pathfinder::loadMap() {
+    auto map = std::make_shared<PathMap>();
+    map->walkability.build();
+    map->jumps.build(map->walkability);
+    map->clusters.build(map->walkability);
+    current = map;
+    mainWorkspace().clusters.forgetGoal();
+    FlowField::getInstance().reset();
+}
+
+void Pathfinder::tilesChanged(ivec2 lo, ivec2 hi) {
+    auto map = std::make_shared<PathMap>(*current);
+    map->walkability.refresh(lo, hi);
+    // a jump can run the length of the map, so the whole table goes
+    map->jumps.build(map->walkability);
+    map->clusters.rebuild(map->walkability, lo, hi);
+    current = map;
+    mainWorkspace().clusters.forgetGoal();
+    // the flow field keeps its own copy of the tiles around the player
+    FlowField::getInstance().tilesChanged(lo, hi);
+}
+
+const WalkabilityGrid& Pathfinder::grid() {
+    static const WalkabilityGrid none;
+    return current ? current->walkability : none;
+}
+
+const JumpTable& Pathfinder::jumpTable() {
+    static const JumpTable none;
+    return current ? current->jumps : none;
+}
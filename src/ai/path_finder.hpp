@@ -1,6 +1,9 @@
 #pragma once
 
 #include <vector>
+#include <array>
+#include <cstdint>
+#include <memory>
 #include <glm/vec2.hpp>
 
 // For tile coordinates, we use ivec2 (from glm)
@@ -11,6 +14,18 @@ struct Direction {
     int cost; // cost to move in this direction (e.g., 10 for cardinal, 14 for diagonal)
 };
 
+// the moves every tile search uses, in the order neighbours are tried
+inline const std::array<Direction, 8> PATH_DIRECTIONS = {{
+    { ivec2(0, -1), 10 },   // up
+    { ivec2(1, 0), 10 },    // right
+    { ivec2(0, 1), 10 },    // down
+    { ivec2(-1, 0), 10 },   // left
+    { ivec2(1, -1), 14 },   // up-right
+    { ivec2(1, 1), 14 },    // down-right
+    { ivec2(-1, 1), 14 },   // down-left
+    { ivec2(-1, -1), 14 }   // up-left
+}};
+
 // A simple A* node.
 struct Node {
     ivec2 position;
@@ -43,9 +58,107 @@ struct IVec2Hash {
     }
 };
 
+// Which tiles can be walked on, one bit per tile, taken from MapSystem when the map is loaded. Off the map is not
+// walkable. Searches read this instead of decoding tiles.
+class WalkabilityGrid {
+public:
+    void build();
+    // re-reads the tiles in [lo, hi] from MapSystem
+    void refresh(ivec2 lo, ivec2 hi);
+    bool walkable(int x, int y) const {
+        if (x < 0 || y < 0 || x >= width || y >= height) {
+            return false;
+        }
+        return (bits[size_t(y) * wordsPerRow + size_t(x) / 64] >> (x % 64)) & 1;
+    }
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+private:
+    int width = 0, height = 0;
+    size_t wordsPerRow = 0;
+    std::vector<uint64_t> bits; // row major, bit x % 64 of word x / 64 in a row
+};
+
+// JPS+: for every tile and each of the PATH_DIRECTIONS, how far a jump point search can go in one step. Built from
+// the walkability grid when the map is loaded. Diagonals may cut corners, like in the tile A*.
+class JumpTable {
+public:
+    void build(const WalkabilityGrid& grid);
+    // > 0: that many steps in PATH_DIRECTIONS[dir] lands on a jump point. Otherwise there are -distance walkable
+    // tiles before a wall and no jump point on the way.
+    int distance(int x, int y, int dir) const { return jumps[(size_t(y) * width + x) * 8 + dir]; }
+private:
+    int width = 0, height = 0;
+    std::vector<int16_t> jumps; // 8 per tile, in PATH_DIRECTIONS order
+};
+
+// Everything one A* search needs, kept between searches so they don't allocate: per tile arrays sized to the map,
+// where an entry only counts if its stamp is the current search's generation (so nothing is cleared in between), and
+// the open list's buffer. One context runs one search at a time.
+// The open list keeps duplicates instead of decreasing keys; nodes with equal f come out in the same order as they
+// did from the std::priority_queue this replaced, so paths are the same tile for tile.
+class PathfindingContext {
+public:
+    std::vector<ivec2> findPath(const WalkabilityGrid& grid, const ivec2& start, const ivec2& goal, bool limitIterations);
+    // Same path cost as an exact A* (and the same result shape as findPath, tile by tile), but only jump points go
+    // through the open list. Ties between equally cheap routes can go another way than findPath's.
+    std::vector<ivec2> findJumpPath(const WalkabilityGrid& grid, const JumpTable& jumps, const ivec2& start, const ivec2& goal, bool limitIterations);
+    size_t lastExpansions() const { return expansions; }
+private:
+    struct OpenNode {
+        int f;
+        int G;
+        ivec2 position;
+    };
+    struct Later {
+        bool operator()(const OpenNode& a, const OpenNode& b) const { return a.f > b.f; }
+    };
+
+    int width = 0, height = 0;
+    uint32_t generation = 0;
+    std::vector<uint32_t> stamp;
+    std::vector<int> gScore;
+    std::vector<ivec2> cameFrom;
+    std::vector<OpenNode> open;
+    size_t expansions = 0;
+
+    void reset(const WalkabilityGrid& grid);
+    bool seen(int32_t cell) const { return stamp[cell] == generation; }
+};
+
+enum class PathMode {
+    ASTAR,
+    JUMP_POINT
+};
+
+struct PathMap;
+struct PathWorkspace;
+
 class Pathfinder {
 public:
     // Returns a vector of tile indices (ivec2) representing the path.
     // If no path is found, returns an empty vector.
     static std::vector<ivec2> findPath(const ivec2& start, const ivec2& goal, bool limitIterations = false);
-};
\ No newline at end of file
+    // For goals that may be far off: goes through the cluster graph (see ClusterGraph) and only returns the first
+    // few clusters of the way there, ask again once they're walked
+    static std::vector<ivec2> findLongPath(const ivec2& start, const ivec2& goal);
+    // the same two on a given map with the caller's scratch, for searches off the main thread
+    static std::vector<ivec2> findPath(const PathMap& map, PathWorkspace& workspace, const ivec2& start, const ivec2& goal, bool limitIterations);
+    static std::vector<ivec2> findLongPath(const PathMap& map, PathWorkspace& workspace, const ivec2& start, const ivec2& goal);
+
+    // builds the walkability grid, jump table and cluster graph, MapSystem calls this once the map is loaded
+    static void loadMap();
+    // call after the tiles in [lo, hi] changed, replaces the current map with an updated copy
+    static void tilesChanged(ivec2 lo, ivec2 hi);
+    // the current map, stays valid for whoever holds it however the tiles change afterwards
+    static std::shared_ptr<const PathMap> snapshot() { return current; }
+    static const WalkabilityGrid& grid();
+    static const JumpTable& jumpTable();
+
+    // what findPath and findLongPath (the cluster graph's tile searches) search with, A* unless --path-mode jps
+    static void setMode(PathMode newMode) { mode = newMode; }
+    static PathMode getMode() { return mode; }
+private:
+    inline static std::shared_ptr<const PathMap> current;
+    inline static PathMode mode = PathMode::ASTAR;
+};
@@ -0,0 +1,18 @@
+#pragma once
+
+#include "path_finder.hpp"
+#include "cluster_graph.hpp"
+
+// Everything the path searches read about the map. When tiles change Pathfinder builds a new one instead of editing
+// the old, so whoever still holds the old one (a search on a PathService worker) keeps a consistent map.
+struct PathMap {
+    WalkabilityGrid walkability;
+    JumpTable jumps;
+    ClusterGraph clusters;
+};
+
+// Scratch for searching PathMaps, one per thread
+struct PathWorkspace {
+    PathfindingContext context;
+    ClusterGraph::Scratch clusters;
+};
@@ -0,0 +1,158 @@
+#include "path_service.hpp"
+#include <util/debug.hpp>
+#include <algorithm>
+#include <chrono>
+
+void PathService::start(size_t threads) {
+    stop();
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = false;
+    for (size_t i = 0; i < threads; ++i) {
+        workers.emplace_back([this]() { work(); });
+    }
+}
+
+void PathService::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    workers.clear();
+}
+
+PathService::Handle PathService::request(ivec2 start, ivec2 goal) {
+    std::lock_guard<std::mutex> lock(mutex);
+    Handle handle = nextHandle++;
+    if (nextHandle == NO_REQUEST) {
+        nextHandle = 1;
+    }
+    results[handle] = Result();
+
+    std::shared_ptr<const PathMap> map = Pathfinder::snapshot();
+    if (!map) {
+        results[handle].done = true; // no map, nowhere to go
+        results[handle].doneTick = tick;
+        return handle;
+    }
+    // join a job for the same goal that hasn't started yet
+    for (Job& job : queue) {
+        if (job.goal != goal || job.map != map) {
+            continue;
+        }
+        auto it = std::find(job.starts.begin(), job.starts.end(), start);
+        if (it != job.starts.end()) {
+            job.handles[it - job.starts.begin()].push_back(handle);
+        }
+        else {
+            job.starts.push_back(start);
+            job.handles.push_back({ handle });
+        }
+        return handle;
+    }
+    queue.push_back(Job{ std::move(map), goal, { start }, { { handle } } });
+    wake.notify_one();
+    return handle;
+}
+
+PathService::PollResult PathService::poll(Handle handle, std::vector<ivec2>& path) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = results.find(handle);
+    if (it == results.end()) {
+        return PollResult::UNKNOWN;
+    }
+    if (!it->second.done) {
+        return PollResult::PENDING;
+    }
+    path = std::move(it->second.path);
+    results.erase(it);
+    return PollResult::DONE;
+}
+
+void PathService::cancel(Handle handle) {
+    std::lock_guard<std::mutex> lock(mutex);
+    results.erase(handle);
+}
+
+void PathService::step() {
+    std::unique_lock<std::mutex> lock(mutex);
+    debug_printf(DebugType::TIME, "PATH: %d searches in %.2f ms last tick, %zu jobs queued, %zu requests open\n",
+        searchesThisTick, msThisTick, queue.size(), results.size());
+    tick++;
+    searchesLeft = MAX_SEARCHES_PER_TICK;
+    msLeft = BUDGET_MS;
+    searchesThisTick = 0;
+    msThisTick = 0.f;
+    for (auto it = results.begin(); it != results.end(); ) {
+        if (it->second.done && tick - it->second.doneTick > UNCLAIMED_TICKS) {
+            it = results.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+
+    if (workers.empty()) {
+        while (!queue.empty() && budgetLeft()) {
+            runJob(lock, inlineWorkspace);
+        }
+    }
+    else {
+        wake.notify_all();
+    }
+}
+
+void PathService::work() {
+    PathWorkspace workspace;
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        wake.wait(lock, [this]() { return stopping || (!queue.empty() && budgetLeft()); });
+        if (stopping) return;
+        runJob(lock, workspace);
+    }
+}
+
+void PathService::runJob(std::unique_lock<std::mutex>& lock, PathWorkspace& workspace) {
+    Job job = std::move(queue.front());
+    queue.pop_front();
+    // the goal costs cached in the scratch may be for another map
+    workspace.clusters.forgetGoal();
+
+    size_t next = 0;
+    for (; next < job.starts.size() && budgetLeft(); ++next) {
+        const auto& handles = job.handles[next];
+        bool wanted = std::any_of(handles.begin(), handles.end(), [this](Handle handle) { return results.count(handle) > 0; });
+        if (!wanted) {
+            continue; // everyone who asked cancelled
+        }
+        searchesLeft--;
+
+        lock.unlock();
+        auto t0 = std::chrono::steady_clock::now();
+        std::vector<ivec2> path = Pathfinder::findLongPath(*job.map, workspace, job.starts[next], job.goal);
+        float ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - t0).count();
+        lock.lock();
+
+        msLeft -= ms;
+        msThisTick += ms;
+        searchesThisTick++;
+        for (Handle handle : handles) {
+            auto it = results.find(handle);
+            if (it != results.end()) {
+                it->second.done = true;
+                it->second.doneTick = tick;
+                it->second.path = path;
+            }
+        }
+    }
+
+    // out of budget: the rest goes back to the front for the next tick
+    if (next < job.starts.size()) {
+        job.starts.erase(job.starts.begin(), job.starts.begin() + next);
+        job.handles.erase(job.handles.begin(), job.handles.begin() + next);
+        queue.push_front(std::move(job));
+    }
+}
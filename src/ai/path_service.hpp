@@ -0,0 +1,90 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <unordered_map>
+#include <cstdint>
+#include "path_map.hpp"
+
+// Runs Pathfinder::findLongPath off the main thread. A state asks for a path with request() and keeps the handle;
+// poll() hands the path over once it's done, until then the state keeps walking whatever path it had.
+// Requests for the same goal tile go out as one job (one search per distinct start, and the goal's side of the
+// cluster graph is only searched once). Each job searches the PathMap that was current when it was queued.
+// A tick only starts so many searches (MAX_SEARCHES_PER_TICK, BUDGET_MS of search time), the rest wait for the
+// next tick. With no worker threads step() runs the jobs itself, under the same budget.
+class PathService {
+public:
+    using Handle = uint32_t;
+    static constexpr Handle NO_REQUEST = 0;
+
+    static constexpr int MAX_SEARCHES_PER_TICK = 32;
+    static constexpr float BUDGET_MS = 2.f;
+    // done paths nobody polls (their mob died mid request) are dropped after this many ticks
+    static constexpr uint32_t UNCLAIMED_TICKS = 300;
+
+    static PathService& getInstance() {
+        static PathService instance;
+        return instance;
+    }
+
+    void start(size_t threads);
+    void stop();
+
+    enum class PollResult {
+        PENDING, // still queued or being searched
+        DONE,    // the path was moved out and the handle is spent
+        UNKNOWN  // never issued, cancelled, or done but unclaimed for UNCLAIMED_TICKS: request again
+    };
+
+    Handle request(ivec2 start, ivec2 goal);
+    PollResult poll(Handle handle, std::vector<ivec2>& path);
+    void cancel(Handle handle);
+
+    // once a tick on the main thread, before the AI runs
+    void step();
+
+private:
+    PathService() = default;
+    ~PathService() { stop(); }
+    PathService(const PathService&) = delete;
+    PathService& operator=(const PathService&) = delete;
+
+    struct Job {
+        std::shared_ptr<const PathMap> map;
+        ivec2 goal;
+        std::vector<ivec2> starts;
+        std::vector<std::vector<Handle>> handles; // who asked for each start
+    };
+    struct Result {
+        bool done = false;
+        uint32_t doneTick = 0;
+        std::vector<ivec2> path;
+    };
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping = false;
+
+    std::deque<Job> queue;
+    std::unordered_map<Handle, Result> results;
+    Handle nextHandle = 1;
+    uint32_t tick = 0;
+    // what's left of this tick's budget
+    int searchesLeft = MAX_SEARCHES_PER_TICK;
+    float msLeft = BUDGET_MS;
+    // for the TIME line
+    int searchesThisTick = 0;
+    float msThisTick = 0.f;
+
+    PathWorkspace inlineWorkspace; // for step() when there are no workers
+
+    bool budgetLeft() const { return searchesLeft > 0 && msLeft > 0.f; }
+    void work();
+    // runs the front job; called with lock held, which is let go during the searches
+    void runJob(std::unique_lock<std::mutex>& lock, PathWorkspace& workspace);
+};
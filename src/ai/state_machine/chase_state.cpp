@@ -7,6 +7,7 @@
 #include <iostream>
 #include "patrol_state.hpp"
 #include <ai/path_finder.hpp>
+#include <ai/flow_field.hpp>
 #include <map/map_system.hpp>
 
 #include <util/debug.hpp>
@@ -15,20 +16,48 @@
 
 
 void ChaseState::regeneratePath(entt::registry& registry, ivec2 startTile, ivec2 targetTile) {
-    currentPath = Pathfinder::findPath(startTile, targetTile);
+    // one search at a time, the one in flight is at most a tick old
+    if (pathRequest == PathService::NO_REQUEST) {
+        pathRequest = PathService::getInstance().request(startTile, targetTile);
+    }
+    pathRecalcTimer = 0.0f;
+}
+
+bool ChaseState::collectPath(entt::registry& registry) {
+    if (pathRequest == PathService::NO_REQUEST) {
+        return true;
+    }
+    std::vector<ivec2> path;
+    PathService::PollResult result = PathService::getInstance().poll(pathRequest, path);
+    if (result == PathService::PollResult::PENDING) {
+        return true;
+    }
+    pathRequest = PathService::NO_REQUEST;
+    if (result == PathService::PollResult::UNKNOWN) {
+        // e.g. the path came in while the mob was asleep and expired
+        return false;
+    }
+    currentPath = std::move(path);
     // remove the first tile since it is the current tile
     if (!currentPath.empty()) {
         currentPath.erase(currentPath.begin());
     }
 
     currentWaypointIndex = 0;
-    pathRecalcTimer = 0.0f;
 
     if (debugMode) {
         for (auto tile : currentPath) {
             createDebugTile(registry, tile);
         }
     }
+    return true;
+}
+
+void ChaseState::cancelPath() {
+    if (pathRequest != PathService::NO_REQUEST) {
+        PathService::getInstance().cancel(pathRequest);
+        pathRequest = PathService::NO_REQUEST;
+    }
 }
 
 
@@ -55,7 +84,11 @@ void ChaseState::onEnter(entt::registry& registry, entt::entity entity) {
     ivec2 enemyTile = ivec2(MapSystem::get_tile_indices(footPos));
     ivec2 playerTile = ivec2(MapSystem::get_tile_indices(playerFootPos));
 
-    regeneratePath(registry, enemyTile, playerTile);
+    // near the player the shared flow field is followed instead
+    ivec2 step;
+    if (!FlowField::getInstance().next(enemyTile, step) && enemyTile != FlowField::getInstance().goal()) {
+        regeneratePath(registry, enemyTile, playerTile);
+    }
 
     // animation
     if (registry.any_of<AnimationComponent>(entity)) {
@@ -71,10 +104,36 @@ void ChaseState::onUpdate(entt::registry& registry, entt::entity entity, float d
 
     auto& motion = registry.get<Motion>(entity);
     vec2 footPos = motion.position + motion.offset_to_ground;
-    
+
+    // Near the player, step along the shared flow field; the own A* path is only for mobs it doesn't reach.
+    FlowField& field = FlowField::getInstance();
+    ivec2 enemyTile = ivec2(MapSystem::get_tile_indices(footPos));
+    ivec2 step;
+    if (field.next(enemyTile, step)) {
+        cancelPath();
+        currentPath.clear();
+        currentWaypointIndex = 0;
+        pathRecalcTimer = 0.0f;
+
+        vec2 toStep = MapSystem::get_tile_center_pos(vec2(step.x, step.y)) - footPos;
+        float distance = length(toStep);
+        auto& aiComp = registry.get<AIComponent>(entity);
+        const AIConfig& config = aiComp.stateMachine->getConfig();
+        motion.velocity = distance > 0.f ? dist(gen) * (toStep / distance) * config.chaseSpeed : vec2(0.f);
+        return;
+    }
+    if (enemyTile == field.goal()) {
+        // on the player's tile, same as reaching the end of a path
+        motion.velocity = {0, 0};
+        return;
+    }
+
     // Update the path recalculation timer.
     pathRecalcTimer += deltaTime;
     const float pathRecalcInterval = 1000.0f; // Recalculate path every 1000ms.
+    if (!collectPath(registry)) {
+        pathRecalcTimer = pathRecalcInterval; // ask again right away
+    }
     if (pathRecalcTimer >= pathRecalcInterval) {
         pathRecalcTimer = 0.0f;
         
@@ -159,6 +218,7 @@ void ChaseState::onExit(entt::registry& registry, entt::entity entity) {
     // std::cout << "v = 0 (4)" << std::endl;
 
     motion.velocity = {0, 0};
+    cancelPath();
     currentPath.clear();
     currentWaypointIndex = 0;
     pathRecalcTimer = 0.0f;
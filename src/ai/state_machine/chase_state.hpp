@@ -1,6 +1,7 @@
 #pragma once
 
 #include "ai_state.hpp"
+#include <ai/path_service.hpp>
 #include <iostream>
 
 class ChaseState : public AIState {
@@ -20,8 +21,13 @@ private:
     int currentWaypointIndex = 0;
     // Timer to control how often the path is recalculated.
     float pathRecalcTimer = 0.0f;
+    // the path being searched for, currentPath is followed until it comes in
+    PathService::Handle pathRequest = PathService::NO_REQUEST;
 
     void regeneratePath(entt::registry& registry, ivec2 startTile, ivec2 targetTile);
+    // false if the request was lost (see PathService::PollResult::UNKNOWN) and has to be made again
+    bool collectPath(entt::registry& registry);
+    void cancelPath();
 
     bool debugMode = false;
 };
\ No newline at end of file
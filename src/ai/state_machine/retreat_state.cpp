@@ -5,6 +5,7 @@
 #include "ai/state_machine/transition.hpp"
 #include <map/map_system.hpp>
 #include "ai/path_finder.hpp"
+#include "collision/raycast.hpp"
 #include <glm/glm.hpp>
 #include <iostream>
 #include <algorithm>
@@ -27,40 +28,47 @@ ivec2 RetreatState::computeRetreatDestination(entt::registry& registry, entt::en
     vec2 playerFootPos = playerMotion.position + playerMotion.offset_to_ground;
     
     vec2 retreatDir = normalize(enemyFootPos - playerFootPos);
-    vec2 candidatePos = enemyFootPos + retreatDir * retreatDistance;
-    
-    ivec2 candidateTile = ivec2(MapSystem::get_tile_indices(candidatePos));
 
-    // Use a ray-cast approach: move from candidateTile along the retreat direction until an obstacle is found.
-    ivec2 currentTile = candidateTile;
-    ivec2 step = ivec2(
-        (retreatDir.x > 0) ? 1 : ((retreatDir.x < 0) ? -1 : 0),
-        (retreatDir.y > 0) ? 1 : ((retreatDir.y < 0) ? -1 : 0)
-    );
-    
-    // Limit the number of steps to avoid infinite loops.
-    const int maxSteps = 20;
-    for (int i = 0; i < maxSteps; ++i) {
-        vec2 center = MapSystem::get_tile_center_pos(vec2(currentTile.x, currentTile.y));
-        if (!MapSystem::walkable_tile(MapSystem::get_tile(center))) {
-            // Step back one tile.
-            currentTile = currentTile - step;
-            break;
-        }
-        currentTile = currentTile + step;
+    // Cast once along the retreat direction and stop a tile short of whatever blocks it.
+    float distance = retreatDistance;
+    RayHit hit = raycast(registry, enemyFootPos, retreatDir, retreatDistance, RayMode::MOVEMENT);
+    if (hit.hit) {
+        distance = std::max(0.f, hit.distance - TILE_SIZE);
     }
-    
-    return currentTile;
+    return ivec2(MapSystem::get_tile_indices(enemyFootPos + retreatDir * distance));
 }
 
 void RetreatState::regenerateRetreatPath(entt::registry& registry, entt::entity entity, ivec2 startTile, ivec2 targetTile) {
-    retreatPath = Pathfinder::findPath(startTile, targetTile, true);
+    // a newer destination replaces the search still running for the old one
+    PathService& service = PathService::getInstance();
+    service.cancel(pathRequest);
+    pathRequest = service.request(startTile, targetTile);
+    retreatTarget = targetTile;
+    pathRecalcTimer = 0.0f;
+}
+
+void RetreatState::collectRetreatPath(ivec2 currentTile) {
+    if (pathRequest == PathService::NO_REQUEST) {
+        return;
+    }
+    PathService& service = PathService::getInstance();
+    std::vector<ivec2> path;
+    PathService::PollResult result = service.poll(pathRequest, path);
+    if (result == PathService::PollResult::PENDING) {
+        return;
+    }
+    if (result == PathService::PollResult::UNKNOWN) {
+        // e.g. the path came in while the mob was asleep and expired
+        pathRequest = service.request(currentTile, retreatTarget);
+        return;
+    }
+    pathRequest = PathService::NO_REQUEST;
+    retreatPath = std::move(path);
     if (!retreatPath.empty()) {
         // Optionally remove the first tile if it is the enemy's current tile.
         retreatPath.erase(retreatPath.begin());
     }
     currentWaypointIndex = 0;
-    pathRecalcTimer = 0.0f;
 }
 
 void RetreatState::onEnter(entt::registry& registry, entt::entity entity) {
@@ -107,6 +115,7 @@ void RetreatState::onUpdate(entt::registry& registry, entt::entity entity, float
         ivec2 retreatTile = computeRetreatDestination(registry, entity, config.retreatDistance);
         regenerateRetreatPath(registry, entity, currentTile, retreatTile);
     }
+    collectRetreatPath(currentTile);
     
     // Follow the retreat path if available.
     if (!retreatPath.empty() && currentWaypointIndex < static_cast<int>(retreatPath.size())) {
@@ -131,6 +140,12 @@ void RetreatState::onUpdate(entt::registry& registry, entt::entity entity, float
             const AIConfig& config = static_cast<const AIConfig&>(aiComp.stateMachine->getConfig());
             motion.velocity = direction * config.chaseSpeed;
         }
+    } else if (pathRequest != PathService::NO_REQUEST && currentTile != retreatTarget) {
+        // no path yet, but the destination was raycast clear of anything in the way
+        vec2 toTarget = MapSystem::get_tile_center_pos(vec2(retreatTarget.x, retreatTarget.y)) - footPos;
+        auto& aiComp = registry.get<AIComponent>(entity);
+        const AIConfig& config = static_cast<const AIConfig&>(aiComp.stateMachine->getConfig());
+        motion.velocity = length(toTarget) > 0.f ? normalize(toTarget) * config.chaseSpeed : vec2(0.f);
     } else {
         motion.velocity = {0, 0};
     }
@@ -140,6 +155,8 @@ void RetreatState::onExit(entt::registry& registry, entt::entity entity) {
     debug_printf(DebugType::AI, "Exiting RetreatState\n");
     auto& motion = registry.get<Motion>(entity);
     motion.velocity = {0, 0};
+    PathService::getInstance().cancel(pathRequest);
+    pathRequest = PathService::NO_REQUEST;
     retreatPath.clear();
     currentWaypointIndex = 0;
     pathRecalcTimer = 0.0f;
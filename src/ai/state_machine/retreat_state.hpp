@@ -3,6 +3,7 @@
 #include <iostream>
 
 #include "ai/ai_component.hpp"
+#include "ai/path_service.hpp"
 #include "tinyECS/components.hpp"
 
 
@@ -22,8 +23,13 @@ private:
     int currentWaypointIndex = 0;
     float pathRecalcTimer = 0.0f;
     bool stateComplete = false;
+    // the path being searched for; until the first one comes in the mob heads straight for retreatTarget
+    PathService::Handle pathRequest = PathService::NO_REQUEST;
+    ivec2 retreatTarget = ivec2(0);
     
     ivec2 computeRetreatDestination(entt::registry& registry, entt::entity entity, float retreatDistance);
     
     void regenerateRetreatPath(entt::registry& registry, entt::entity entity, ivec2 startTile, ivec2 targetTile);
+    // asks again from currentTile if the request was lost (see PathService::PollResult::UNKNOWN)
+    void collectRetreatPath(ivec2 currentTile);
 };
\ No newline at end of file
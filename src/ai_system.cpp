@@ -5,6 +5,10 @@
 #include "tinyECS/components.hpp"
 #include "music_system.hpp"
 #include "ai/ai_component.hpp"
+#include "activity_system.hpp"
+#include "ai/flow_field.hpp"
+#include "ai/path_service.hpp"
+#include "map/map_system.hpp"
 	
 AISystem::AISystem(entt::registry& reg) :
 	registry(reg)
@@ -17,15 +21,32 @@ void AISystem::step(float elapsed_ms)
 {
 	(void)elapsed_ms; // placeholder to silence unused warning until implemented
 
-	auto view = registry.view<AIComponent>();
-    for (auto entity : view) {
-        auto& aiComp = view.get<AIComponent>(entity);
-		aiComp.attackCooldownTimer += elapsed_ms;
+	// paths finished since last tick come in, the next batch of requests goes out
+	PathService::getInstance().step();
 
-        if (aiComp.stateMachine) {
-            aiComp.stateMachine->update(elapsed_ms);
-        }
-    }
+	// chasers step along the shared flow field, which only changes when the player moves to another tile
+	auto players = registry.view<Player, Motion>();
+	if (players.begin() != players.end()) {
+		auto& playerMotion = registry.get<Motion>(players.front());
+		FlowField::getInstance().track(ivec2(MapSystem::get_tile_indices(playerMotion.position + playerMotion.offset_to_ground)));
+	}
+
+	// asleep mobs are skipped, low frequency ones run every few ticks with the time they missed
+	auto update = [](AIComponent& aiComp, float step_ms) {
+		aiComp.attackCooldownTimer += step_ms;
+
+		if (aiComp.stateMachine) {
+			aiComp.stateMachine->update(step_ms);
+		}
+	};
+	for (auto&& [entity, aiComp] : registry.view<AIComponent>(entt::exclude<LowFrequency, Asleep>).each()) {
+		update(aiComp, elapsed_ms);
+	}
+	for (auto&& [entity, aiComp, lowFrequency] : registry.view<AIComponent, LowFrequency>().each()) {
+		if (lowFrequency.due) {
+			update(aiComp, elapsed_ms * ActivitySystem::LOW_FREQUENCY_TICKS);
+		}
+	}
 
 }
 
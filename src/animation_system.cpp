@@ -3,70 +3,70 @@
 #include <iostream>
 #include "animation/animation_definition.hpp"
 #include "animation/animation_manager.hpp"
+#include "activity_system.hpp"
 
 void AnimationSystem::update(float deltaTime) {
-    // update animation direction
-    auto view_dir = registry.view<Sprite, AnimationComponent, Motion>();
-    for (auto entity : view_dir) {
-        auto& motion = view_dir.get<Motion>(entity);
-        auto& animComp = view_dir.get<AnimationComponent>(entity);
-        updateAnimationDirection(motion, animComp);
+    // asleep entities are skipped, low frequency ones advance every few ticks by the time they missed
+    auto view = registry.view<Sprite, AnimationComponent, Motion>(entt::exclude<LowFrequency, Asleep>);
+    for (auto&& [entity, sprite, animComp, motion] : view.each()) {
+        animate(sprite, animComp, motion, deltaTime);
     }
+    auto lowFrequency = registry.view<Sprite, AnimationComponent, Motion, LowFrequency>();
+    for (auto&& [entity, sprite, animComp, motion, activity] : lowFrequency.each()) {
+        if (activity.due) {
+            animate(sprite, animComp, motion, deltaTime * ActivitySystem::LOW_FREQUENCY_TICKS);
+        }
+    }
+}
+
+void AnimationSystem::animate(Sprite& sprite, AnimationComponent& animComp, Motion& motion, float deltaTime) {
+    updateAnimationDirection(motion, animComp);
 
+    std::string animationId = AnimationManager::getInstance().buildAnimationKey(
+        animComp.animation_header, animComp.action, animComp.direction);
 
-    // Iterate over all entities with both Sprite and Animation components.
-    auto view = registry.view<Sprite, AnimationComponent, Motion>();
-    for (auto entity : view) {
-        auto& sprite = view.get<Sprite>(entity);
-        auto& animComp = view.get<AnimationComponent>(entity);
-        auto& motion   = view.get<Motion>(entity);
+    // const AnimationDefinition* animDef = AnimationManager::getInstance().getAnimation(animComp.currentAnimationId);
+    const AnimationDefinition* animDef = AnimationManager::getInstance().getAnimation(animationId);
+    if (!animDef) {
 
-        std::string animationId = AnimationManager::getInstance().buildAnimationKey(
+        if (animComp.direction == MotionDirection::UP || animComp.direction == MotionDirection::DOWN) {
+            // Set flip flag based on horizontal velocity and set canonical direction to RIGHT.
+            vec2 velocity = motion.velocity.x == 0 ? animComp.lastNormalizedVelocity : motion.velocity;
+            
+            animComp.flip = (velocity.x < 0);
+            animComp.direction = MotionDirection::RIGHT;
+        }
+        // Rebuild key after fallback.
+        animationId = AnimationManager::getInstance().buildAnimationKey(
             animComp.animation_header, animComp.action, animComp.direction);
+        animDef = AnimationManager::getInstance().getAnimation(animationId);
 
-        // const AnimationDefinition* animDef = AnimationManager::getInstance().getAnimation(animComp.currentAnimationId);
-        const AnimationDefinition* animDef = AnimationManager::getInstance().getAnimation(animationId);
         if (!animDef) {
-
-            if (animComp.direction == MotionDirection::UP || animComp.direction == MotionDirection::DOWN) {
-                // Set flip flag based on horizontal velocity and set canonical direction to RIGHT.
-                vec2 velocity = motion.velocity.x == 0 ? animComp.lastNormalizedVelocity : motion.velocity;
-                
-                animComp.flip = (velocity.x < 0);
-                animComp.direction = MotionDirection::RIGHT;
-            }
-            // Rebuild key after fallback.
-            animationId = AnimationManager::getInstance().buildAnimationKey(
-                animComp.animation_header, animComp.action, animComp.direction);
-            animDef = AnimationManager::getInstance().getAnimation(animationId);
-
-            if (!animDef) {
-                std::cerr << "AnimationSystem: Animation definition not found for fallback key: " << animationId << "\n";
-                continue;
-            }
+            std::cerr << "AnimationSystem: Animation definition not found for fallback key: " << animationId << "\n";
+            return;
         }
+    }
 
-        float currentFrameDuration = animDef->frameDurations[animComp.currentFrameIndex];
-        
-        animComp.timer += deltaTime;
-        if (animComp.timer >= currentFrameDuration) {
-            animComp.timer = 0.0f;
-            animComp.currentFrameIndex++;
-            // Wrap around if needed.
-            if (animComp.currentFrameIndex >= static_cast<int>(animDef->frames.size())) {
-                animComp.currentFrameIndex = animDef->loop ? 0 : (int)animDef->frames.size() - 1;
-            }
+    float currentFrameDuration = animDef->frameDurations[animComp.currentFrameIndex];
+    
+    animComp.timer += deltaTime;
+    if (animComp.timer >= currentFrameDuration) {
+        animComp.timer = 0.0f;
+        animComp.currentFrameIndex++;
+        // Wrap around if needed.
+        if (animComp.currentFrameIndex >= static_cast<int>(animDef->frames.size())) {
+            animComp.currentFrameIndex = animDef->loop ? 0 : (int)animDef->frames.size() - 1;
         }
-        
-        sprite.coord = animDef->frames[animComp.currentFrameIndex];
-        sprite.dims = vec2(animDef->frameWidth, animDef->frameHeight);
+    }
+    
+    sprite.coord = animDef->frames[animComp.currentFrameIndex];
+    sprite.dims = vec2(animDef->frameWidth, animDef->frameHeight);
 
-        // apply flip
-        if (animComp.flip) {
-            motion.scale.x = -std::abs(motion.scale.x);
-        } else {
-            motion.scale.x = std::abs(motion.scale.x);
-        }
+    // apply flip
+    if (animComp.flip) {
+        motion.scale.x = -std::abs(motion.scale.x);
+    } else {
+        motion.scale.x = std::abs(motion.scale.x);
     }
 }
 
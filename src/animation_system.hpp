@@ -28,4 +28,7 @@ public:
 
 private:
     entt::registry& registry;
+
+    // direction, then advances the frame timer and updates the sprite
+    void animate(Sprite& sprite, AnimationComponent& animComp, Motion& motion, float deltaTime);
 };
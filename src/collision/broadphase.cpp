@@ -0,0 +1,73 @@
+#include "broadphase.hpp"
+#include "hitbox.hpp"
+#include <cmath>
+
+bool Broadphase::sweeps(const entt::registry& registry, entt::entity entity) {
+    if (registry.all_of<Projectile>(entity)) return true;
+    const Dash* dash = registry.try_get<Dash>(entity);
+    return dash && dash->inUse;
+}
+
+Broadphase::Item Broadphase::makeItem(const entt::registry& registry, entt::entity entity) {
+    const auto& motion = registry.get<Motion>(entity);
+    const auto& hitbox = registry.get<Hitbox>(entity);
+    vec2 lo = hitbox.shape->aabb_min + motion.position;
+    vec2 hi = hitbox.shape->aabb_max + motion.position;
+    bool swept = sweeps(registry, entity) && !std::isnan(motion.formerPosition.x) && !std::isnan(motion.formerPosition.y);
+    if (swept) {
+        lo = glm::min(lo, hitbox.shape->aabb_min + motion.formerPosition);
+        hi = glm::max(hi, hitbox.shape->aabb_max + motion.formerPosition);
+    }
+    CollisionMask mask = COLLISION_MATRIX[int(hitbox.type)] & hitbox.mask;
+    return Item{ entity, lo.x, hi.x, lo.y, hi.y, layer_bit(hitbox.type), mask, swept };
+}
+
+void Broadphase::update(const entt::registry& registry, const std::vector<entt::entity>& entities) {
+    present.clear();
+    for (size_t i = 0; i < entities.size(); ++i) {
+        present.emplace(entities[i], i);
+    }
+
+    // keep last frame's order for whatever is still around, refreshing its bounds
+    kept.assign(entities.size(), false);
+    size_t count = 0;
+    for (const Item& item : items) {
+        auto it = present.find(item.entity);
+        if (it == present.end() || kept[it->second]) {
+            continue;
+        }
+        kept[it->second] = true;
+        items[count++] = makeItem(registry, item.entity);
+    }
+    items.resize(count);
+    for (size_t i = 0; i < entities.size(); ++i) {
+        if (!kept[i] && present[entities[i]] == i) {
+            items.push_back(makeItem(registry, entities[i]));
+        }
+    }
+
+    // insertion sort, nearly sorted already
+    for (size_t i = 1; i < items.size(); ++i) {
+        Item item = items[i];
+        size_t j = i;
+        while (j > 0 && items[j - 1].minX > item.minX) {
+            items[j] = items[j - 1];
+            --j;
+        }
+        items[j] = item;
+    }
+
+    // sweep, touching counts as overlapping like in the SAT test
+    candidatePairs.clear();
+    candidateSwept.clear();
+    for (size_t i = 0; i < items.size(); ++i) {
+        const Item& a = items[i];
+        for (size_t j = i + 1; j < items.size() && items[j].minX <= a.maxX; ++j) {
+            const Item& b = items[j];
+            if ((a.mask & b.layer) && (b.mask & a.layer) && a.minY <= b.maxY && b.minY <= a.maxY) {
+                candidatePairs.emplace_back(a.entity, b.entity);
+                candidateSwept.push_back(a.swept || b.swept);
+            }
+        }
+    }
+}
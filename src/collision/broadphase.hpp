@@ -0,0 +1,44 @@
+#pragma once
+
+#include "common.hpp"
+#include "hitbox.hpp"
+#include <entt.hpp>
+#include <vector>
+#include <unordered_map>
+#include <utility>
+
+// Sort-and-sweep on x over hitbox AABBs. The sorted order is kept between frames, so the insertion sort only has to
+// fix up what moved past its neighbours (close to O(n) since little changes per frame). Only pairs whose AABBs
+// overlap and whose layers interact (COLLISION_MATRIX and Hitbox::mask) come out, everything else never reaches the
+// SAT test.
+// Fast movers (see sweeps) get the AABB of their whole move this step, from formerPosition to position, so nothing
+// they pass through is missed at low frame rates.
+class Broadphase {
+public:
+    // entities must have Motion and Hitbox
+    void update(const entt::registry& registry, const std::vector<entt::entity>& entities);
+    // pairs with overlapping AABBs, valid until the next update
+    const std::vector<std::pair<entt::entity, entt::entity>>& pairs() const { return candidatePairs; }
+    // per pair, whether either side is swept and needs collides_swept
+    const std::vector<uint8_t>& sweptPairs() const { return candidateSwept; }
+    size_t size() const { return items.size(); }
+
+    // projectiles and the player mid dash move far enough in a step to skip over a hitbox
+    static bool sweeps(const entt::registry& registry, entt::entity entity);
+private:
+    struct Item {
+        entt::entity entity;
+        float minX, maxX, minY, maxY;
+        CollisionMask layer; // own layer bit
+        CollisionMask mask;  // layers it interacts with
+        bool swept;
+    };
+
+    std::vector<Item> items; // sorted by minX
+    std::vector<std::pair<entt::entity, entt::entity>> candidatePairs;
+    std::vector<uint8_t> candidateSwept;
+    std::unordered_map<entt::entity, size_t> present; // entity -> index into this frame's input
+    std::vector<bool> kept;
+
+    static Item makeItem(const entt::registry& registry, entt::entity entity);
+};
@@ -0,0 +1,76 @@
+#include "collision_system.hpp"
+#include <chrono>
+#include <random>
+#include <cstdio>
+
+// --collision-bench: the same seeded pair set through narrowphase at 1, 2, 4 and 8 threads
+void CollisionSystem::runBenchmark(int objects, unsigned seed) {
+    using BenchClock = std::chrono::steady_clock;
+    const size_t threadsBefore = workers ? workers->size() : 1;
+
+    // its own registry, so nothing in the game's is touched
+    entt::registry bench;
+    std::mt19937 rng(seed);
+    // a screen per 1024 objects, about as crowded as a big fight gets
+    const float side = WINDOW_WIDTH_PX * std::sqrt(std::max(objects, 1) / 1024.f);
+    std::uniform_real_distribution<float> coord(0.f, side), step(-12.f, 12.f), size(8.f, 24.f), layer(0.f, 1.f);
+    std::vector<entt::entity> entities;
+    entities.reserve(objects);
+    for (int i = 0; i < objects; ++i) {
+        entt::entity entity = bench.create();
+        auto& motion = bench.emplace<Motion>(entity);
+        motion.position = { coord(rng), coord(rng) };
+        auto& hitbox = bench.emplace<Hitbox>(entity);
+        float half = size(rng);
+        hitbox.shape = intern_shape({ { -half, -half }, { half, -half }, { half, half }, { -half, half } });
+        // mostly mobs and projectiles like a busy fight, projectiles swept from where they were last step
+        float roll = layer(rng);
+        if (roll < 0.02f) {
+            hitbox.type = ColliderType::PLAYER;
+        }
+        else if (roll < 0.55f) {
+            hitbox.type = ColliderType::CREATURE;
+        }
+        else {
+            hitbox.type = ColliderType::PROJECTILE;
+            bench.emplace<Projectile>(entity);
+            motion.formerPosition = motion.position + vec2(step(rng), step(rng));
+        }
+        entities.push_back(entity);
+    }
+
+    broadphase.update(bench, entities);
+    queries.clear();
+    for (auto [e1, e2] : broadphase.pairs()) {
+        queries.push_back(CollisionQuery{
+            &bench.get<Hitbox>(e1), &bench.get<Motion>(e1),
+            &bench.get<Hitbox>(e2), &bench.get<Motion>(e2) });
+    }
+    std::printf("collision bench: %d objects, %zu candidate pairs\n", objects, queries.size());
+
+    const int rounds = 200;
+    std::vector<uint32_t> reference;
+    for (size_t threads : { 1, 2, 4, 8 }) {
+        setThreads(threads);
+        // every thread count starts from the same empty contact cache
+        contactCache.clear();
+        narrowphase();
+        if (threads == 1) reference = hits;
+        bool same = hits == reference;
+
+        auto t0 = BenchClock::now();
+        for (int round = 0; round < rounds; ++round) {
+            narrowphase();
+            same = same && hits == reference;
+        }
+        double ms = std::chrono::duration<double, std::milli>(BenchClock::now() - t0).count() / rounds;
+        std::printf("collision bench: %zu threads %.4f ms/narrowphase, %zu hits, cache %zu / %zu%s\n", threads, ms,
+            hits.size(), stats.cacheHits, stats.cacheLookups, same ? "" : " (MISMATCH)");
+    }
+
+    // the game's queries pointed into bench, don't leave them around
+    queries.clear();
+    hits.clear();
+    contactCache.clear();
+    setThreads(threadsBefore);
+}
@@ -6,11 +6,12 @@
 #include "util/debug.hpp"
 
 
-CollisionSystem::CollisionSystem(entt::registry& reg, WorldSystem& world, PhysicsSystem& physics, QuadTree& quadTree, SpawnSystem& spawnSystem, FlagSystem& flagSystem) :
+CollisionSystem::CollisionSystem(entt::registry& reg, WorldSystem& world, PhysicsSystem& physics, QuadTree& quadTree, SpatialGrid& dynamicGrid, SpawnSystem& spawnSystem, FlagSystem& flagSystem) :
 	registry(reg),
 	physics(physics),
 	world(world),
 	quadTree(quadTree),
+	dynamicGrid(dynamicGrid),
 	spawnSystem(spawnSystem), 
 	flagSystem(flagSystem)
 {
@@ -23,6 +24,10 @@ CollisionSystem::CollisionSystem(entt::registry& reg, WorldSystem& world, Physic
 void CollisionSystem::step(float elapsed_ms) {
 	processed.clear();
 	destroy_entities.clear();
+	knockbacks.clear();
+	hurtMobs.clear();
+	hitSounds = 0;
+	playerHurt = false;
 	//quadTree->clear(); 
 
 	
@@ -50,48 +55,69 @@ void CollisionSystem::step(float elapsed_ms) {
 	);
 
 	//creating a query for all entities in range of player screen
-	std::vector<entt::entity> nearbyEntities = quadTree.quadTree->queryRange(rangeQuad, registry);
-	auto mobs = registry.view<Mob>(); 
-	for (auto mob : mobs) {
-		nearbyEntities.push_back(mob); 
-	}
-	auto projectiles = registry.view<Projectile>(); 
-	for (auto projectile : projectiles) {
-		nearbyEntities.push_back(projectile); 
-	}
-	auto slashes = registry.view<Slash>(); 
-	for (auto slash : slashes) {
-		nearbyEntities.push_back(slash); 
-	}
+	nearbyEntities.clear();
+	quadTree.visitRange(rangeQuad, registry, [this](entt::entity entity) {
+		// baked into the static layer, nothing left for the broadphase to do with it
+		if (registry.get<Hitbox>(entity).mask != 0) nearbyEntities.push_back(entity);
+		return true;
+	});
+	// mobs, projectiles and slashes near the player
+	dynamicGrid.queryRange(rangeQuad, nearbyEntities);
 	nearbyEntities.push_back(playerEntity); 
-	
-	//std::cout << nearbyEntities.size() << std::endl;
-
-	for (size_t i = 0; i < nearbyEntities.size(); ++i) {
-		auto e1 = nearbyEntities[i];
-		// Skip if this entity has already been processed
-		if (processed.find(e1) != processed.end()) continue;
-
-		const auto& m1 = registry.get<Motion>(e1);
-		const auto& h1 = registry.get<Hitbox>(e1);
-
-		for (size_t j = i + 1; j < nearbyEntities.size(); ++j) {
-			auto e2 = nearbyEntities[j];
-
-			if (processed.find(e2) != processed.end()) continue;
 
-			const auto& m2 = registry.get<Motion>(e2);
-			const auto& h2 = registry.get<Hitbox>(e2);
-
-			if (collides(h1, m1, h2, m2)) {
-				//std::cout << "coo" << std::endl; 
-				resolve(e1, e2, elapsed_ms);
-				processHandler(e1, e2);
-			}
+	// environment first, one grid lookup each
+	size_t staticTests = 0;
+	for (auto entity : nearbyEntities) {
+		ColliderType type = registry.get<Hitbox>(entity).type;
+		if (type == ColliderType::PLAYER || type == ColliderType::PROJECTILE) {
+			resolveStatic(entity);
+			staticTests++;
 		}
 	}
-
 	
+	// only pairs whose AABBs overlap get the full SAT test
+	broadphase.update(registry, nearbyEntities);
+	const auto& pairs = broadphase.pairs();
+
+	// SAT test every candidate pair up front in one batch
+	queries.clear();
+	for (auto [e1, e2] : pairs) {
+		queries.push_back(CollisionQuery{
+			&registry.get<Hitbox>(e1), &registry.get<Motion>(e1),
+			&registry.get<Hitbox>(e2), &registry.get<Motion>(e2) });
+	}
+	stats = Stats();
+	narrowphase();
+
+	// earliest impact first so a fast projectile hits the first thing on its path. Everything not swept has toi 0
+	// and keeps its pair order (stable)
+	std::stable_sort(hits.begin(), hits.end(), [this](uint32_t a, uint32_t b) {
+		return hitToi[a] < hitToi[b];
+	});
+
+	// detection, nothing changes here besides which projectiles have used up their hit
+	contacts.clear();
+	for (uint32_t i : hits) {
+		auto [e1, e2] = pairs[i];
+		// Skip if either entity has already been processed
+		if (processed.find(e1) != processed.end() || processed.find(e2) != processed.end()) continue;
+
+		const ContactRule& rule = contactRules[int(queries[i].h_a->type)][int(queries[i].h_b->type)];
+		if (rule.kind != ContactKind::NONE) {
+			contacts.push_back(rule.swap ? Contact{ e2, e1, rule.kind } : Contact{ e1, e2, rule.kind });
+		}
+		processHandler(e1, e2);
+	}
+
+	stats.pairs = pairs.size();
+	stats.threads = workers ? workers->size() : 1;
+	stats.staticTests = staticTests;
+	dispatchContacts(elapsed_ms);
+	debug_printf(DebugType::TIME, "COLL: %zu objects, %zu candidate pairs, %zu contacts, %zu static tests, %zu knockbacks, %zu deaths, %zu threads\n",
+		broadphase.size(), stats.pairs, contacts.size(), stats.staticTests, stats.knockbacks, stats.deaths, stats.threads);
+	debug_printf(DebugType::TIME, "COLL: contact cache %zu / %zu hits (%.0f%%)\n", stats.cacheHits, stats.cacheLookups,
+		stats.cacheLookups ? 100.f * stats.cacheHits / stats.cacheLookups : 0.f);
+
 	for (auto entity : destroy_entities) {
 		if (registry.valid(entity)) {
 			if (registry.any_of<Mob>(entity)) {
@@ -110,7 +136,7 @@ void CollisionSystem::step(float elapsed_ms) {
 			registry.destroy(entity);
 		}
 	}
-	for (auto slash : slashes) {
+	for (auto slash : registry.view<Slash>()) {
 		if (!registry.valid(slash)) {
 			continue; // Skip if the entity is not valid
 		}
@@ -119,23 +145,113 @@ void CollisionSystem::step(float elapsed_ms) {
 	}
 }
 
-void CollisionSystem::processHandler(entt::entity& e1, entt::entity& e2) {
-	if (registry.all_of<Projectile>(e1)) processed.insert(e1);
-	if (registry.all_of<Projectile>(e2)) processed.insert(e2);
+void CollisionSystem::setThreads(size_t threads) {
+	workers = threads > 1 ? std::make_unique<ThreadPool>(threads) : nullptr;
 }
 
-template<typename C1, typename C2>
-bool CollisionSystem::collision_type(entt::entity& e1, entt::entity& e2) {
-	if (registry.all_of<C1>(e1) && registry.all_of<C2>(e2)) {
-		return true;
+void CollisionSystem::narrowphase() {
+	// axes that separated these pairs last step
+	const auto& pairs = broadphase.pairs();
+	pairHints.resize(queries.size());
+	size_t cacheLookups = 0;
+	for (size_t i = 0; i < pairs.size(); ++i) {
+		auto it = contactCache.find(pairKey(pairs[i].first, pairs[i].second));
+		pairHints[i] = it != contactCache.end() ? it->second : NO_AXIS;
+		cacheLookups += pairHints[i] != NO_AXIS;
 	}
-	else if (registry.all_of<C1>(e2) && registry.all_of<C2>(e1)) {
-		std::swap(e1, e2);
-		return true;
+
+	// not worth waking the workers for a handful of pairs
+	const size_t minPairsPerLane = 64;
+	size_t lanes = workers ? std::min(workers->size(), std::max<size_t>(1, queries.size() / minPairsPerLane)) : 1;
+	queryResults.resize(queries.size());
+	hitToi.resize(queries.size());
+	if (laneHits.size() < lanes) laneHits.resize(lanes);
+	laneSettled.assign(lanes, 0);
+	const auto& swept = broadphase.sweptPairs();
+
+	// contiguous slices, lane l takes [l * n / lanes, (l + 1) * n / lanes)
+	auto testSlice = [this, lanes, &swept](size_t lane) {
+		if (lane >= lanes) return;
+		size_t begin = lane * queries.size() / lanes;
+		size_t end = (lane + 1) * queries.size() / lanes;
+		laneSettled[lane] = collides_batch(queries.data() + begin, end - begin, queryResults.data() + begin, pairHints.data() + begin);
+		auto& out = laneHits[lane];
+		out.clear();
+		for (size_t i = begin; i < end; ++i) {
+			hitToi[i] = 0.f;
+			if (swept[i]) {
+				// also catches what it passed through on the way, not just where it ended up
+				const CollisionQuery& q = queries[i];
+				float toi;
+				if (collides_swept(*q.h_a, *q.m_a, *q.h_b, *q.m_b, toi)) {
+					hitToi[i] = toi;
+					queryResults[i] = 1;
+				}
+			}
+			if (queryResults[i]) out.push_back(uint32_t(i));
+		}
+	};
+	if (lanes > 1) workers->run(testSlice);
+	else testSlice(0);
+
+	// lanes in order, so hits come out in pair order whatever the thread count
+	hits.clear();
+	stats.cacheHits = 0;
+	for (size_t lane = 0; lane < lanes; ++lane) {
+		hits.insert(hits.end(), laneHits[lane].begin(), laneHits[lane].end());
+		stats.cacheHits += laneSettled[lane];
+	}
+	stats.cacheLookups = cacheLookups;
+
+	nextContactCache.clear();
+	for (size_t i = 0; i < pairs.size(); ++i) {
+		nextContactCache.emplace(pairKey(pairs[i].first, pairs[i].second), pairHints[i]);
 	}
-	return false;
+	std::swap(contactCache, nextContactCache);
+}
+
+uint64_t CollisionSystem::pairKey(entt::entity a, entt::entity b) {
+	uint64_t x = entt::to_integral(a), y = entt::to_integral(b);
+	return x < y ? (x << 32) | y : (y << 32) | x;
 }
 
+void CollisionSystem::resolveStatic(entt::entity entity) {
+	const StaticLayer& staticLayer = StaticLayer::getInstance();
+	const auto& hitbox = registry.get<Hitbox>(entity);
+	auto& motion = registry.get<Motion>(entity);
+	if (!(hitbox.mask & layer_bit(ColliderType::OBSTACLE))) return;
+	if (!staticLayer.blocked(hitbox, motion)) {
+		// fast movers can hop over a trunk in one step, check what they passed
+		float freeUntil;
+		if (!Broadphase::sweeps(registry, entity) || std::isnan(motion.formerPosition.x) ||
+			!staticLayer.sweep(hitbox, motion, freeUntil)) return;
+		if (hitbox.type == ColliderType::PLAYER) {
+			// the dash stops in front of the obstacle instead of going through it
+			motion.position = motion.formerPosition + (motion.position - motion.formerPosition) * freeUntil;
+			return;
+		}
+	}
+
+	if (hitbox.type == ColliderType::PROJECTILE) {
+		destroy_entities.push_back(entity);
+		processed.insert(entity);
+		return;
+	}
+	// same as handle<Obstacle, Player>: keep whichever axis of the move is still free
+	glm::vec2 invalidPosition = motion.position;
+	motion.position = motion.formerPosition;
+	motion.position.x = invalidPosition.x;
+	if (!staticLayer.blocked(hitbox, motion)) return;
+	motion.position.x = motion.formerPosition.x;
+	motion.position.y = invalidPosition.y;
+	if (!staticLayer.blocked(hitbox, motion)) return;
+	motion.position = motion.formerPosition;
+}
+
+void CollisionSystem::processHandler(entt::entity& e1, entt::entity& e2) {
+	if (registry.all_of<Projectile>(e1)) processed.insert(e1);
+	if (registry.all_of<Projectile>(e2)) processed.insert(e2);
+}
 
 template<>
 void CollisionSystem::handle<Player, Mob>(
@@ -143,21 +259,15 @@ void CollisionSystem::handle<Player, Mob>(
 ) {
 	auto& player = registry.get<Player>(play_ent);
 	auto& mob = registry.get<Mob>(mob_ent);
-	auto& screen = registry.get<ScreenState>(registry.view<ScreenState>().front());
 
 	if (mob.hit_time > 0) return;
 
 	debug_printf(DebugType::COLLISION, "Player-mob collision!\n");
 	mob.hit_time = 1.f; // TODO: make this a constant
 	player.health -= MOB_DAMAGE;
-	MusicSystem::playSoundEffect(SFX::HIT);
-
-	UISystem::updatePlayerHealthBar(registry, player.currMaxHealth, player.health);
-	physics.knockback(play_ent, mob_ent, 300);
-	physics.suppress(play_ent, mob_ent);
-	
-	screen.darken_screen_factor = std::min(1.f - ((float) player.health) / ((float) player.currMaxHealth), 1.0f);
-	// screen.darken_screen_factor = std::min(screen.darken_screen_factor + 0.33f, 1.0f);
+	hitSounds++;
+	playerHurt = true;
+	knockbacks.push_back({ play_ent, mob_ent, 300, true });
 }
 
 template<>
@@ -178,22 +288,9 @@ void CollisionSystem::handle<Projectile, Mob>(
 
 	debug_printf(DebugType::COLLISION, "Bullet-mob collision!\n");
 	mob.health -= projectile.damage;
-	MusicSystem::playSoundEffect(SFX::HIT);
-
-	UISystem::updateMobHealthBar(registry, mob_ent, true);
-	if (mob.health <= 0) {
-		for (auto &&[hb_ent, healthbar] : registry.view<MobHealthBar>().each()) {
-			if (healthbar.entity == mob_ent) {
-				destroy_entities.insert(hb_ent);
-				break;
-			}
-		}
-		if (registry.any_of<Drop>(mob_ent)) {
-			UISystem::mobDrop(registry, mob_ent);
-		}
-		destroy_entities.insert(mob_ent);
-	}
-	destroy_entities.insert(proj_ent);
+	hitSounds++;
+	hurtMobs.push_back(mob_ent);
+	destroy_entities.push_back(proj_ent);
 }
 
 template<>
@@ -211,19 +308,14 @@ void CollisionSystem::handle<Projectile, Player>(
 	}
 
 	auto& player = registry.get<Player>(play_ent);
-	auto& screen = registry.get<ScreenState>(registry.view<ScreenState>().front());
 
 	debug_printf(DebugType::COLLISION, "Bullet-player collision!\n");
 	player.health -= projectile.damage;
-	MusicSystem::playSoundEffect(SFX::HIT);
-
-	UISystem::updatePlayerHealthBar(registry, player.currMaxHealth, player.health);
-	physics.knockback(play_ent, proj_ent, 300);
-	
-	screen.darken_screen_factor = std::min(1.f - ((float) player.health) / ((float) player.currMaxHealth), 1.0f);
-
-	destroy_entities.insert(proj_ent);
+	hitSounds++;
+	playerHurt = true;
+	knockbacks.push_back({ play_ent, proj_ent, 300, false });
 
+	destroy_entities.push_back(proj_ent);
 }
 
 // could've probably written the logic much clearer. 
@@ -264,7 +356,7 @@ void CollisionSystem::handle<Projectile, Obstacle>(
 	entt::entity proj_ent, entt::entity obs_ent, float elapsed_ms
 ) {
 	if (!registry.any_of<Ship>(obs_ent)) {
-		destroy_entities.insert(proj_ent);
+		destroy_entities.push_back(proj_ent);
 	}
 }
 
@@ -281,34 +373,94 @@ void CollisionSystem::handle<Slash, Mob>(
 
 	debug_printf(DebugType::COLLISION, "Slash-mob collision!\n");
 	mob.health -= slash.damage;
-	MusicSystem::playSoundEffect(SFX::HIT);
-
-	UISystem::updateMobHealthBar(registry, mob_ent, true);
-	if (mob.health <= 0) {
-		for (auto&& [hb_ent, healthbar] : registry.view<MobHealthBar>().each()) {
-			if (healthbar.entity == mob_ent) {
-				destroy_entities.insert(hb_ent);
-				break;
-			}
-		}
-		if (registry.any_of<Drop>(mob_ent)) {
-			UISystem::mobDrop(registry, mob_ent);
-		}
-		destroy_entities.insert(mob_ent);
-	}
-	else {
+	hitSounds++;
+	hurtMobs.push_back(mob_ent);
+	if (mob.health > 0) {
 		auto player_ent = registry.view<Player>().front();
-		physics.knockback(mob_ent, player_ent, slash.force); 
+		knockbacks.push_back({ mob_ent, player_ent, slash.force, false });
 	}
 }
 
-void CollisionSystem::resolve(entt::entity e1, entt::entity e2, float elapsed_ms) {
-	if (collision_type<Player, Mob>(e1, e2))      handle<Player, Mob>(e1, e2, elapsed_ms);
-	else if (collision_type<Projectile, Mob>(e1, e2))  handle<Projectile, Mob>(e1, e2, elapsed_ms);
-	else if (collision_type<Projectile, Obstacle>(e1, e2)) handle<Projectile, Obstacle>(e1, e2, elapsed_ms);
-	else if (collision_type<Projectile, Player>(e1, e2)) handle<Projectile, Player>(e1, e2, elapsed_ms);
-	else if (collision_type<Slash, Mob>(e1, e2)) handle<Slash, Mob>(e1, e2, elapsed_ms); 
+constexpr CollisionSystem::ContactTable CollisionSystem::makeContactTable() {
+	ContactTable table{};
+	auto add = [&table](ColliderType a, ColliderType b, ContactKind kind) {
+		table[int(a)][int(b)] = { kind, false };
+		table[int(b)][int(a)] = { kind, true };
+	};
+	add(ColliderType::PLAYER, ColliderType::CREATURE, ContactKind::PLAYER_MOB);
+	add(ColliderType::PROJECTILE, ColliderType::CREATURE, ContactKind::PROJECTILE_MOB);
+	add(ColliderType::PROJECTILE, ColliderType::OBSTACLE, ContactKind::PROJECTILE_OBSTACLE);
+	add(ColliderType::PROJECTILE, ColliderType::PLAYER, ContactKind::PROJECTILE_PLAYER);
+	add(ColliderType::SLASH, ColliderType::CREATURE, ContactKind::SLASH_MOB);
 	// TODO: when AI gets improved, make all mobs unable to walk into obstacles
-	else if (collision_type<Obstacle, Player>(e1, e2)) handle<Obstacle, Player>(e1, e2, elapsed_ms);
-	// else if (collision_type<Obstacle, Motion>(e1, e2)) handle<Obstacle, Motion>(e1, e2, elapsed_ms);
-}
\ No newline at end of file
+	add(ColliderType::OBSTACLE, ColliderType::PLAYER, ContactKind::OBSTACLE_PLAYER);
+	return table;
+}
+
+constexpr CollisionSystem::ContactTable CollisionSystem::contactRules = CollisionSystem::makeContactTable();
+
+// indexed by ContactKind
+constexpr std::array<CollisionSystem::Handler, size_t(CollisionSystem::ContactKind::COUNT)> CollisionSystem::handlers = {
+	&CollisionSystem::handle<Player, Mob>,
+	&CollisionSystem::handle<Projectile, Mob>,
+	&CollisionSystem::handle<Projectile, Obstacle>,
+	&CollisionSystem::handle<Projectile, Player>,
+	&CollisionSystem::handle<Slash, Mob>,
+	&CollisionSystem::handle<Obstacle, Player>,
+};
+
+void CollisionSystem::dispatchContacts(float elapsed_ms) {
+	// handlers, one kind at a time (stable, so contacts keep their order within a kind)
+	std::stable_sort(contacts.begin(), contacts.end(), [](const Contact& a, const Contact& b) {
+		return a.kind < b.kind;
+	});
+	for (const Contact& contact : contacts) {
+		stats.contacts[size_t(contact.kind)]++;
+		(this->*handlers[size_t(contact.kind)])(contact.a, contact.b, elapsed_ms);
+	}
+
+	// knockback
+	for (Knockback& knockback : knockbacks) {
+		physics.knockback(knockback.target, knockback.source, knockback.force);
+		if (knockback.suppress) physics.suppress(knockback.target, knockback.source);
+	}
+	stats.knockbacks = knockbacks.size();
+
+	// audio, one hit sound per step however many landed
+	if (hitSounds > 0) {
+		MusicSystem::playSoundEffect(SFX::HIT);
+	}
+
+	// health bars
+	if (playerHurt) {
+		auto player_ent = registry.view<Player>().front();
+		auto& player = registry.get<Player>(player_ent);
+		auto& screen = registry.get<ScreenState>(registry.view<ScreenState>().front());
+		UISystem::updatePlayerHealthBar(registry, player.currMaxHealth, player.health);
+		screen.darken_screen_factor = std::min(1.f - ((float) player.health) / ((float) player.currMaxHealth), 1.0f);
+		// screen.darken_screen_factor = std::min(screen.darken_screen_factor + 0.33f, 1.0f);
+	}
+	std::sort(hurtMobs.begin(), hurtMobs.end());
+	hurtMobs.erase(std::unique(hurtMobs.begin(), hurtMobs.end()), hurtMobs.end());
+	for (entt::entity& mob_ent : hurtMobs) {
+		UISystem::updateMobHealthBar(registry, mob_ent, true);
+	}
+
+	// deaths, one pass over the health bars for all of them
+	auto dead = std::partition(hurtMobs.begin(), hurtMobs.end(), [this](entt::entity mob_ent) {
+		return registry.get<Mob>(mob_ent).health <= 0;
+	});
+	stats.deaths = dead - hurtMobs.begin();
+	if (stats.deaths == 0) return;
+	for (auto&& [hb_ent, healthbar] : registry.view<MobHealthBar>().each()) {
+		if (std::find(hurtMobs.begin(), dead, healthbar.entity) != dead) {
+			destroy_entities.push_back(hb_ent);
+		}
+	}
+	for (auto it = hurtMobs.begin(); it != dead; ++it) {
+		if (registry.any_of<Drop>(*it)) {
+			UISystem::mobDrop(registry, *it);
+		}
+		destroy_entities.push_back(*it);
+	}
+}
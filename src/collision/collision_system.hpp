@@ -8,12 +8,17 @@
 #include "world_init.hpp"
 #include "physics_system.hpp"
 #include "collision/hitbox.hpp"
+#include "collision/broadphase.hpp"
+#include "collision/static_layer.hpp"
 #include "quadtree/quadtree.hpp"
+#include "quadtree/spatial_grid.hpp"
 #include "spawn_system.hpp"
 #include "flag_system.hpp"
+#include "util/thread_pool.hpp"
+#include <memory>
 class CollisionSystem {
 public:
-    CollisionSystem(entt::registry& reg, WorldSystem& world, PhysicsSystem& physics, QuadTree& quadTree, SpawnSystem& spawnSystem, FlagSystem& flagSystem);
+    CollisionSystem(entt::registry& reg, WorldSystem& world, PhysicsSystem& physics, QuadTree& quadTree, SpatialGrid& dynamicGrid, SpawnSystem& spawnSystem, FlagSystem& flagSystem);
     void step(float elapsed_ms);
 
     ~CollisionSystem() {
@@ -23,24 +28,100 @@ public:
         }*/
     }
     void initTree(int mapWidth, int mapHeight); //expensive
+    // lanes the narrowphase is split over (--collision-threads), 1 keeps it on the main thread
+    void setThreads(size_t threads);
+    // --collision-bench N: times narrowphase on N seeded objects at 1, 2, 4 and 8 threads and checks every thread
+    // count finds the same hits (collision_bench.cpp). Run it before the game starts, it overwrites the broadphase.
+    void runBenchmark(int objects, unsigned seed);
     
 private:
     entt::registry& registry;
     PhysicsSystem& physics; 
     WorldSystem& world;
     QuadTree& quadTree;
+    SpatialGrid& dynamicGrid;
 	SpawnSystem& spawnSystem;
     FlagSystem& flagSystem;
 
-    std::unordered_set<entt::entity> destroy_entities;
+    std::vector<entt::entity> destroy_entities;
     std::unordered_set<entt::entity> processed;
+    std::vector<entt::entity> nearbyEntities; // reused every step so the query doesn't allocate
+    Broadphase broadphase;
+    std::vector<CollisionQuery> queries;
+    std::vector<uint8_t> queryResults;
+    std::unique_ptr<ThreadPool> workers;
+    std::vector<std::vector<uint32_t>> laneHits; // colliding pair indices found by each lane
+    std::vector<uint32_t> hits;                  // all lanes merged, in pair order
+    std::vector<float> hitToi;                   // per pair, when in the step a swept pair first touches
+    std::vector<size_t> laneSettled;
+    // Contact cache: the separating axis each pair had last step (NO_AXIS if it was touching), tried first this step.
+    // Only pairs seen in the last step are kept.
+    std::unordered_map<uint64_t, int8_t> contactCache, nextContactCache;
+    std::vector<int8_t> pairHints;
+    static uint64_t pairKey(entt::entity a, entt::entity b);
 
-    void processHandler(entt::entity& e1, entt::entity& e2); 
+    // Detection only records contacts; the handlers then run over them grouped by kind, and push what they cause
+    // (knockback, sounds, health bars, deaths) into the buffers below, which are applied one pass each.
+    enum class ContactKind : uint8_t {
+        PLAYER_MOB,
+        PROJECTILE_MOB,
+        PROJECTILE_OBSTACLE,
+        PROJECTILE_PLAYER,
+        SLASH_MOB,
+        OBSTACLE_PLAYER,
+        COUNT,
+        NONE = COUNT
+    };
+    struct Contact {
+        entt::entity a, b; // in the order the handler takes them
+        ContactKind kind;
+    };
+    struct Knockback {
+        entt::entity target, source;
+        float force;
+        bool suppress;
+    };
+    std::vector<Contact> contacts;
+    std::vector<Knockback> knockbacks;
+    std::vector<entt::entity> hurtMobs;
+    size_t hitSounds = 0;
+    bool playerHurt = false;
 
-    template<typename C1, typename C2>
-    bool collision_type(entt::entity& e1, entt::entity& e2);
+    void processHandler(entt::entity& e1, entt::entity& e2); 
 
     template<typename T1, typename T2>
     void handle(entt::entity e1, entt::entity e2, float elapsed_ms);
-    void resolve(entt::entity e1, entt::entity e2, float elapsed_ms);
+    // SAT tests the candidate pairs, splitting them over the workers; fills hits
+    void narrowphase();
+    void dispatchContacts(float elapsed_ms);
+    // player and projectiles against the baked trees and houses
+    void resolveStatic(entt::entity entity);
+
+    // contact kind for a pair of layers, swap if the entities have to go in the other way round
+    struct ContactRule {
+        ContactKind kind = ContactKind::NONE;
+        bool swap = false;
+    };
+    using ContactTable = std::array<std::array<ContactRule, int(ColliderType::COUNT)>, int(ColliderType::COUNT)>;
+    using Handler = void (CollisionSystem::*)(entt::entity, entt::entity, float);
+    // both built at compile time
+    static constexpr ContactTable makeContactTable();
+    static const ContactTable contactRules;
+    static const std::array<Handler, size_t(ContactKind::COUNT)> handlers;
+
+public:
+    // what the last step did, for profiling
+    struct Stats {
+        size_t pairs = 0;
+        size_t threads = 1;
+        size_t staticTests = 0;
+        std::array<size_t, size_t(ContactKind::COUNT)> contacts{};
+        size_t knockbacks = 0;
+        size_t cacheLookups = 0; // pairs with an axis cached from last step
+        size_t cacheHits = 0;    // ...that the cached axis alone separated
+        size_t deaths = 0;
+    };
+    const Stats& getStats() const { return stats; }
+private:
+    Stats stats;
 };
\ No newline at end of file
@@ -1,6 +1,56 @@
 #include <vector>
+#include <map>
+#include <memory>
+#include <cmath>
 #include "hitbox.hpp"
 
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define HITBOX_SSE 1
+#endif
+
+namespace {
+struct PtsLess {
+    bool operator()(const std::vector<vec2>& a, const std::vector<vec2>& b) const {
+        return std::lexicographical_compare(a.begin(), a.end(), b.begin(), b.end(),
+            [](const vec2& p, const vec2& q) { return p.x < q.x || (p.x == q.x && p.y < q.y); });
+    }
+};
+}
+
+const CollisionShape* intern_shape(const std::vector<vec2>& pts) {
+    // function local so creature definitions can intern during static init
+    static std::map<std::vector<vec2>, std::unique_ptr<CollisionShape>, PtsLess> shapes;
+    auto& shape = shapes[pts];
+    if (shape) return shape.get();
+
+    shape = std::make_unique<CollisionShape>();
+    shape->pts = pts;
+    for (const vec2& normal : get_normals(pts)) {
+        bool seen = false;
+        for (const vec2& kept : shape->normals) {
+            if (kept == normal || kept == -normal) {
+                seen = true;
+                break;
+            }
+        }
+        if (!seen) shape->normals.push_back(normal);
+    }
+    if (!pts.empty()) {
+        shape->aabb_min = shape->aabb_max = pts[0];
+        for (const vec2& pt : pts) {
+            shape->aabb_min = glm::min(shape->aabb_min, pt);
+            shape->aabb_max = glm::max(shape->aabb_max, pt);
+        }
+    }
+    return shape.get();
+}
+
+const CollisionShape* empty_shape() {
+    static const CollisionShape* empty = intern_shape({});
+    return empty;
+}
+
 vec2 edge_normal(const vec2& edge) {
     return vec2(-edge.y, edge.x);
 }
@@ -47,23 +97,29 @@ bool overlaps(float minA, float maxA, float minB, float maxB) {
 // project each point of shape onto the axis
 // find min and max value for each shape (if s1 max > s2 min)
 // if we can find 1 axis to separate objects, they are not touching
-bool collides(
+static bool depth_overlaps(
     const Hitbox& h_a, const Motion& m_a,
     const Hitbox& h_b, const Motion& m_b
 ) {
     float a_baseY = (m_a.position + m_a.offset_to_ground).y;
     float b_baseY = (m_b.position + m_b.offset_to_ground).y;
 
-    if (
-        !(a_baseY >= (b_baseY - h_b.depth) && a_baseY <= b_baseY) && // A is not within B's bounds
-        !(b_baseY >= (a_baseY - h_a.depth) && b_baseY <= a_baseY)    // B is not within A's bounds
-    ) return false;
+    return
+        (a_baseY >= (b_baseY - h_b.depth) && a_baseY <= b_baseY) || // A is within B's bounds
+        (b_baseY >= (a_baseY - h_a.depth) && b_baseY <= a_baseY);   // B is within A's bounds
+}
+
+bool collides(
+    const Hitbox& h_a, const Motion& m_a,
+    const Hitbox& h_b, const Motion& m_b
+) {
+    if (!depth_overlaps(h_a, m_a, h_b, m_b)) return false;
 
-    const std::vector<vec2>& ptsA = h_a.pts;
-    const std::vector<vec2>& ptsB = h_b.pts;
+    const std::vector<vec2>& ptsA = h_a.pts();
+    const std::vector<vec2>& ptsB = h_b.pts();
 
-    std::vector<vec2> normalsA = get_normals(ptsA);
-    std::vector<vec2> normalsB = get_normals(ptsB);
+    const std::vector<vec2>& normalsA = h_a.shape->normals;
+    const std::vector<vec2>& normalsB = h_b.shape->normals;
     float minA, maxA, minB, maxB;
 
     for (const vec2& axis : normalsA) {
@@ -85,17 +141,235 @@ bool collides(
     return true;
 }
 
+static const vec2& sat_axis(const Hitbox& h_a, const Hitbox& h_b, int axis) {
+    const auto& normalsA = h_a.shape->normals;
+    return axis < int(normalsA.size()) ? normalsA[axis] : h_b.shape->normals[axis - normalsA.size()];
+}
+
+static bool separates(const Hitbox& h_a, const Motion& m_a, const Hitbox& h_b, const Motion& m_b, int axis) {
+    float minA, maxA, minB, maxB;
+    const vec2& normal = sat_axis(h_a, h_b, axis);
+    project(h_a.pts(), m_a.position, normal, minA, maxA);
+    project(h_b.pts(), m_b.position, normal, minB, maxB);
+    return !overlaps(minA, maxA, minB, maxB);
+}
+
+static bool valid_axis(const Hitbox& h_a, const Hitbox& h_b, int axis) {
+    return axis >= 0 && axis < int(h_a.shape->normals.size() + h_b.shape->normals.size());
+}
+
+bool collides_hinted(
+    const Hitbox& h_a, const Motion& m_a,
+    const Hitbox& h_b, const Motion& m_b,
+    int8_t& hint
+) {
+    if (!depth_overlaps(h_a, m_a, h_b, m_b)) return false;
+    if (valid_axis(h_a, h_b, hint) && separates(h_a, m_a, h_b, m_b, hint)) return false;
+
+    int axes = int(h_a.shape->normals.size() + h_b.shape->normals.size());
+    for (int axis = 0; axis < axes; ++axis) {
+        if (axis != hint && separates(h_a, m_a, h_b, m_b, axis)) {
+            hint = int8_t(axis);
+            return false;
+        }
+    }
+    hint = NO_AXIS;
+    return true;
+}
+
+// where the step starts for swept tests
+static vec2 start_position(const Motion& m) {
+    return std::isnan(m.formerPosition.x) || std::isnan(m.formerPosition.y) ? m.position : m.formerPosition;
+}
+
+// clips [t_first, t_last] to when lo <= start + rate * t <= hi
+static bool clip_interval(float lo, float hi, float start, float rate, float& t_first, float& t_last) {
+    if (rate == 0.f) {
+        return start >= lo && start <= hi;
+    }
+    float t0 = (lo - start) / rate;
+    float t1 = (hi - start) / rate;
+    if (t0 > t1) std::swap(t0, t1);
+    t_first = std::max(t_first, t0);
+    t_last = std::min(t_last, t1);
+    return t_first <= t_last;
+}
+
+// Treats B as still and A as moving by the difference of their moves; on every SAT axis the two projections
+// overlap for one interval of t, and so does the depth check on the bases, so they touch where all of these meet.
+bool collides_swept(
+    const Hitbox& h_a, const Motion& m_a,
+    const Hitbox& h_b, const Motion& m_b,
+    float& toi
+) {
+    const vec2 a0 = start_position(m_a);
+    const vec2 b0 = start_position(m_b);
+    const vec2 d = (m_a.position - a0) - (m_b.position - b0);
+
+    float t_first = 0.f, t_last = 1.f;
+
+    // same as the depth check in collides(), (A base - B base) has to be in [-B depth, A depth]
+    float base_diff = (a0.y + m_a.offset_to_ground.y) - (b0.y + m_b.offset_to_ground.y);
+    if (!clip_interval(-h_b.depth, h_a.depth, base_diff, d.y, t_first, t_last)) return false;
+
+    float minA, maxA, minB, maxB;
+    for (const auto* normals : { &h_a.shape->normals, &h_b.shape->normals }) {
+        for (const vec2& axis : *normals) {
+            project(h_a.pts(), a0, axis, minA, maxA);
+            project(h_b.pts(), b0, axis, minB, maxB);
+            // A's interval shifted by rate * t overlaps B's while minB - maxA <= shift <= maxB - minA
+            if (!clip_interval(minB - maxA, maxB - minA, 0.f, dot(d, axis), t_first, t_last)) return false;
+        }
+    }
+    toi = t_first;
+    return true;
+}
+
+#ifdef HITBOX_SSE
+namespace {
+constexpr int QUAD_PTS = 4;
+constexpr int QUAD_AXES = 2 * QUAD_PTS; // 4 per shape, padded by repeating the last one
+
+bool is_quad(const Hitbox& h) {
+    return h.shape->pts.size() == QUAD_PTS && !h.shape->normals.empty();
+}
+
+// lane l of the output bits is set if queries[lanes[l]] collide. Does the same float ops as project() (add the
+// centre, then x * x + y * y), so the projections and therefore the answers match the scalar path exactly.
+// If sepAxis is given, it gets the first separating axis of each lane (NO_AXIS for the hits).
+int collides_quads(const CollisionQuery* queries, const size_t lanes[4], int8_t* sepAxis = nullptr) {
+    alignas(16) float ax[QUAD_PTS][4], ay[QUAD_PTS][4], bx[QUAD_PTS][4], by[QUAD_PTS][4];
+    alignas(16) float nx[QUAD_AXES][4], ny[QUAD_AXES][4];
+    for (int l = 0; l < 4; ++l) {
+        const CollisionQuery& q = queries[lanes[l]];
+        const CollisionShape& a = *q.h_a->shape;
+        const CollisionShape& b = *q.h_b->shape;
+        for (int i = 0; i < QUAD_PTS; ++i) {
+            ax[i][l] = a.pts[i].x + q.m_a->position.x;
+            ay[i][l] = a.pts[i].y + q.m_a->position.y;
+            bx[i][l] = b.pts[i].x + q.m_b->position.x;
+            by[i][l] = b.pts[i].y + q.m_b->position.y;
+        }
+        for (int k = 0; k < QUAD_PTS; ++k) {
+            const vec2& na = a.normals[std::min<size_t>(k, a.normals.size() - 1)];
+            const vec2& nb = b.normals[std::min<size_t>(k, b.normals.size() - 1)];
+            nx[k][l] = na.x;
+            ny[k][l] = na.y;
+            nx[QUAD_PTS + k][l] = nb.x;
+            ny[QUAD_PTS + k][l] = nb.y;
+        }
+    }
+
+    __m128 hit = _mm_cmpeq_ps(_mm_setzero_ps(), _mm_setzero_ps()); // all lanes set
+    __m128 firstSep = _mm_set1_ps(-1.f);
+    for (int k = 0; k < QUAD_AXES; ++k) {
+        __m128 axisX = _mm_load_ps(nx[k]);
+        __m128 axisY = _mm_load_ps(ny[k]);
+        __m128 minA = _mm_add_ps(_mm_mul_ps(_mm_load_ps(ax[0]), axisX), _mm_mul_ps(_mm_load_ps(ay[0]), axisY));
+        __m128 minB = _mm_add_ps(_mm_mul_ps(_mm_load_ps(bx[0]), axisX), _mm_mul_ps(_mm_load_ps(by[0]), axisY));
+        __m128 maxA = minA, maxB = minB;
+        for (int i = 1; i < QUAD_PTS; ++i) {
+            __m128 projA = _mm_add_ps(_mm_mul_ps(_mm_load_ps(ax[i]), axisX), _mm_mul_ps(_mm_load_ps(ay[i]), axisY));
+            __m128 projB = _mm_add_ps(_mm_mul_ps(_mm_load_ps(bx[i]), axisX), _mm_mul_ps(_mm_load_ps(by[i]), axisY));
+            minA = _mm_min_ps(minA, projA);
+            maxA = _mm_max_ps(maxA, projA);
+            minB = _mm_min_ps(minB, projB);
+            maxB = _mm_max_ps(maxB, projB);
+        }
+        // separated if maxA < minB || maxB < minA, same as overlaps()
+        __m128 separated = _mm_or_ps(_mm_cmplt_ps(maxA, minB), _mm_cmplt_ps(maxB, minA));
+        __m128 firstTime = _mm_and_ps(separated, hit);
+        firstSep = _mm_or_ps(_mm_and_ps(firstTime, _mm_set1_ps(float(k))), _mm_andnot_ps(firstTime, firstSep));
+        hit = _mm_andnot_ps(separated, hit);
+    }
+    if (sepAxis) {
+        alignas(16) float first[4];
+        _mm_store_ps(first, firstSep);
+        for (int l = 0; l < 4; ++l) {
+            int k = int(first[l]);
+            if (k < 0) {
+                sepAxis[l] = NO_AXIS;
+                continue;
+            }
+            // undo the padding: k < 4 is A's normal min(k, nA - 1), the rest B's
+            const CollisionQuery& q = queries[lanes[l]];
+            int nA = int(q.h_a->shape->normals.size()), nB = int(q.h_b->shape->normals.size());
+            sepAxis[l] = int8_t(k < QUAD_PTS ? std::min(k, nA - 1) : nA + std::min(k - QUAD_PTS, nB - 1));
+        }
+    }
+    return _mm_movemask_ps(hit);
+}
+}
+#endif
+
+void collides_batch(const std::vector<CollisionQuery>& queries, std::vector<uint8_t>& results) {
+    results.resize(queries.size());
+    collides_batch(queries.data(), queries.size(), results.data());
+}
+
+size_t collides_batch(const CollisionQuery* queries, size_t count, uint8_t* results, int8_t* hints) {
+    size_t settled = 0;
+#ifdef HITBOX_SSE
+    size_t lanes[4];
+    int8_t sepAxis[4];
+    int filled = 0;
+    auto flush = [&](int used) {
+        int bits = collides_quads(queries, lanes, hints ? sepAxis : nullptr);
+        for (int l = 0; l < used; ++l) {
+            results[lanes[l]] = (bits >> l) & 1;
+            if (hints) hints[lanes[l]] = sepAxis[l];
+        }
+    };
+    for (size_t i = 0; i < count; ++i) {
+        const CollisionQuery& q = queries[i];
+        results[i] = 0;
+        if (!depth_overlaps(*q.h_a, *q.m_a, *q.h_b, *q.m_b)) continue;
+        if (hints && valid_axis(*q.h_a, *q.h_b, hints[i]) && separates(*q.h_a, *q.m_a, *q.h_b, *q.m_b, hints[i])) {
+            settled++;
+            continue;
+        }
+        if (!is_quad(*q.h_a) || !is_quad(*q.h_b)) {
+            results[i] = hints ? collides_hinted(*q.h_a, *q.m_a, *q.h_b, *q.m_b, hints[i]) : collides(*q.h_a, *q.m_a, *q.h_b, *q.m_b);
+            continue;
+        }
+        lanes[filled++] = i;
+        if (filled == 4) {
+            flush(4);
+            filled = 0;
+        }
+    }
+    if (filled > 0) {
+        // pad with the last real query, the extra lanes are thrown away
+        for (int l = filled; l < 4; ++l) lanes[l] = lanes[filled - 1];
+        flush(filled);
+    }
+#else
+    for (size_t i = 0; i < count; ++i) {
+        const CollisionQuery& q = queries[i];
+        if (hints) {
+            int8_t hint = hints[i];
+            results[i] = collides_hinted(*q.h_a, *q.m_a, *q.h_b, *q.m_b, hints[i]);
+            settled += !results[i] && hint != NO_AXIS && hint == hints[i] && depth_overlaps(*q.h_a, *q.m_a, *q.h_b, *q.m_b);
+        }
+        else {
+            results[i] = collides(*q.h_a, *q.m_a, *q.h_b, *q.m_b);
+        }
+    }
+#endif
+    return settled;
+}
+
 bool get_collision_normal(
     const Hitbox& h_a, const Motion& m_a,
     const Hitbox& h_b, const Motion& m_b,
     vec2& collision_normal
 ) {
     // Access the vertices of each hitbox.
-    const std::vector<vec2>& ptsA = h_a.pts;
-    const std::vector<vec2>& ptsB = h_b.pts;
-    // Get all normals for each shape.
-    std::vector<vec2> normalsA = get_normals(ptsA);
-    std::vector<vec2> normalsB = get_normals(ptsB);
+    const std::vector<vec2>& ptsA = h_a.pts();
+    const std::vector<vec2>& ptsB = h_b.pts();
+    // Precomputed normals for each shape.
+    const std::vector<vec2>& normalsA = h_a.shape->normals;
+    const std::vector<vec2>& normalsB = h_b.shape->normals;
 
     float min_overlap = std::numeric_limits<float>::infinity();
     vec2 best_axis;
@@ -148,4 +422,39 @@ bool get_collision_normal(
     // debug_printf(DebugType::HITBOX, "Normal obtained: (%.1f, %.1f)\n", collision_normal.x, collision_normal.y);
     //debug_printf(DebugType::WORLD, "Restarting...\n");  collision_normal.x << " " << collision_normal.y << std::endl;
     return true;
-}
\ No newline at end of file
+}
+
+// Cyrus-Beck: clip the segment against every edge's half plane
+bool segment_hits(
+    const Hitbox& h, const Motion& m,
+    vec2 origin, vec2 dir, float max_dist, float& t
+) {
+    const std::vector<vec2>& pts = h.pts();
+    int size = pts.size();
+    if (size < 3) return false;
+
+    vec2 centre(0.f);
+    for (const vec2& pt : pts) centre += pt;
+    centre /= float(size);
+
+    float t_enter = 0.f;
+    float t_exit = max_dist;
+    for (int i = 0; i < size; ++i) {
+        vec2 normal = edge_normal(pts[(i + 1) % size] - pts[i]);
+        // winding isn't fixed, make the normal point outwards
+        if (dot(normal, pts[i] - centre) < 0) normal = -normal;
+
+        float dist = dot(normal, pts[i] + m.position - origin);
+        float denom = dot(normal, dir);
+        if (denom == 0.f) {
+            if (dist < 0) return false; // parallel and outside this edge
+            continue;
+        }
+        float edge_t = dist / denom;
+        if (denom < 0) t_enter = std::max(t_enter, edge_t);
+        else t_exit = std::min(t_exit, edge_t);
+        if (t_enter > t_exit) return false;
+    }
+    t = t_enter;
+    return true;
+}
@@ -4,16 +4,44 @@
 #include "tinyECS/components.hpp"
 #include "util/debug.hpp"
 // TODO: handle circles (should be relatively trivial)
-// optimizations:
-// - precompute normals and store 1 "mesh" for each shape type
-// - remove collinear axes (this might be slower due to O(n^2) check
 
 constexpr int EPSILON = 10;
 
+// Immutable outline shared by every hitbox with the same points (see intern_shape). Normals are precomputed with
+// exact duplicates and negations (parallel edges) dropped, since they'd give the same SAT axis.
+struct CollisionShape {
+    std::vector<vec2> pts;     // relative to the entity's position
+    std::vector<vec2> normals;
+    vec2 aabb_min = {0.f, 0.f};
+    vec2 aabb_max = {0.f, 0.f};
+};
+
+// returns the one shape with exactly these points, creating it the first time. Shapes live for the whole program.
+const CollisionShape* intern_shape(const std::vector<vec2>& pts);
+const CollisionShape* empty_shape();
+
+// Collision layers, one bit per ColliderType
+using CollisionMask = uint8_t;
+constexpr CollisionMask layer_bit(ColliderType type) { return CollisionMask(1u << int(type)); }
+constexpr CollisionMask ALL_LAYERS = CollisionMask((1u << int(ColliderType::COUNT)) - 1);
+
+// which layers each layer has a handler with (see CollisionSystem::resolve), symmetric. Anything else, like
+// obstacle vs obstacle or mob vs mob, never leaves the broadphase.
+constexpr CollisionMask COLLISION_MATRIX[int(ColliderType::COUNT)] = {
+    /* PLAYER     */ layer_bit(ColliderType::CREATURE) | layer_bit(ColliderType::PROJECTILE) | layer_bit(ColliderType::OBSTACLE),
+    /* CREATURE   */ layer_bit(ColliderType::PLAYER) | layer_bit(ColliderType::PROJECTILE) | layer_bit(ColliderType::SLASH),
+    /* PROJECTILE */ layer_bit(ColliderType::PLAYER) | layer_bit(ColliderType::CREATURE) | layer_bit(ColliderType::OBSTACLE),
+    /* OBSTACLE   */ layer_bit(ColliderType::PLAYER) | layer_bit(ColliderType::PROJECTILE),
+    /* SLASH      */ layer_bit(ColliderType::CREATURE),
+};
+
 struct Hitbox {
     float depth = EPSILON;
-    std::vector<vec2> pts;
-    ColliderType type;
+    const CollisionShape* shape = empty_shape();
+    ColliderType type = ColliderType::OBSTACLE;
+    CollisionMask mask = ALL_LAYERS; // layers this one may hit, on top of COLLISION_MATRIX
+
+    const std::vector<vec2>& pts() const { return shape->pts; }
 };
 
 vec2 edge_normal(const vec2& edge);
@@ -30,8 +58,46 @@ bool collides(
     const Hitbox& h_a, const Motion& m_a,
     const Hitbox& h_b, const Motion& m_b
 );
+
+// Continuous collides(): both hitboxes move in a straight line from formerPosition to position over the step (a NaN
+// formerPosition counts as not moving). True if they touch at any point of it, toi being the first moment as a
+// fraction of the step. Includes the end of the step, so it's true whenever collides() is.
+bool collides_swept(
+    const Hitbox& h_a, const Motion& m_a,
+    const Hitbox& h_b, const Motion& m_b,
+    float& toi
+);
+
+// One SAT test for collides_batch.
+struct CollisionQuery {
+    const Hitbox* h_a;
+    const Motion* m_a;
+    const Hitbox* h_b;
+    const Motion* m_b;
+};
+// results[i] = collides(queries[i]), bit for bit. Pairs of 4 point shapes are tested 4 at a time with SSE, anything
+// else (and builds without SSE) goes through collides().
+void collides_batch(const std::vector<CollisionQuery>& queries, std::vector<uint8_t>& results);
+// same for queries[0, count), results must hold count entries. With hints (see collides_hinted), hints[i] is tried
+// first and updated; returns how many pairs the hint alone settled.
+size_t collides_batch(const CollisionQuery* queries, size_t count, uint8_t* results, int8_t* hints = nullptr);
+
+// SAT axes of a pair are numbered A's normals, then B's
+constexpr int8_t NO_AXIS = -1;
+// collides(), but tests axis hint first, and leaves the separating axis it found in hint (NO_AXIS if they collide).
+// Pairs that stay apart usually stay apart along the same axis, so next time that single projection settles it.
+bool collides_hinted(
+    const Hitbox& h_a, const Motion& m_a,
+    const Hitbox& h_b, const Motion& m_b,
+    int8_t& hint
+);
 bool get_collision_normal(
     const Hitbox& h_a, const Motion& m_a,
     const Hitbox& h_b, const Motion& m_b,
     vec2& collision_normal
+);
+// does origin + dir * t, t in [0, max_dist] hit the (convex) hitbox? t is where it enters
+bool segment_hits(
+    const Hitbox& h, const Motion& m,
+    vec2 origin, vec2 dir, float max_dist, float& t
 ); 
\ No newline at end of file
@@ -0,0 +1,49 @@
+#include "raycast.hpp"
+#include "hitbox.hpp"
+#include "map/map_system.hpp"
+#include "quadtree/quadtree.hpp"
+
+static bool blocks_movement(Tile tile) {
+    return !MapSystem::walkable_tile(tile);
+}
+
+RayHit raycast(const entt::registry& registry, vec2 origin, vec2 dir, float max_dist, RayMode mode) {
+    RayHit result;
+    float len = length(dir);
+    if (len == 0.f) return result;
+    dir /= len;
+
+    float hit_dist;
+    ivec2 hit_tile;
+    auto blocks = mode == RayMode::MOVEMENT ? &blocks_movement : &MapSystem::blocks_sight;
+    if (MapSystem::raycast_tiles(origin, dir, max_dist, blocks, hit_dist, hit_tile)) {
+        result.hit = true;
+        result.distance = hit_dist;
+        result.tile = hit_tile;
+        max_dist = hit_dist; // obstacles only matter if they're closer
+    }
+
+    if (auto tree = registry.ctx().find<QuadTree*>()) {
+        (*tree)->visitSegment(origin, dir, max_dist, [&](entt::entity entity, float) {
+            const Obstacle* obstacle = registry.try_get<Obstacle>(entity);
+            const Hitbox* hitbox = registry.try_get<Hitbox>(entity);
+            float t;
+            if (obstacle && !obstacle->isPassable && hitbox &&
+                segment_hits(*hitbox, registry.get<Motion>(entity), origin, dir, max_dist, t)) {
+                result.hit = true;
+                result.distance = t;
+                result.tile = {-1, -1};
+                result.entity = entity;
+                max_dist = t;
+            }
+            return max_dist;
+        });
+    }
+
+    if (result.hit) result.point = origin + dir * result.distance;
+    return result;
+}
+
+bool has_line_of_sight(const entt::registry& registry, vec2 from, vec2 to) {
+    return !raycast(registry, from, to - from, length(to - from)).hit;
+}
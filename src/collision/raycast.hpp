@@ -0,0 +1,24 @@
+#pragma once
+
+#include "common.hpp"
+#include <entt.hpp>
+
+// what stops a ray: MOVEMENT uses walkability (water blocks), SIGHT only solid decorations
+enum class RayMode {
+    MOVEMENT,
+    SIGHT,
+};
+
+struct RayHit {
+    bool hit = false;
+    float distance = 0.f;              // along the ray
+    vec2 point = {0.f, 0.f};
+    ivec2 tile = {-1, -1};             // set when a tile stopped the ray
+    entt::entity entity = entt::null;  // set when an obstacle stopped the ray
+};
+
+// First thing blocking origin + dir * t, t in [0, max_dist]: tiles are walked with a DDA and impassable obstacles
+// come from the quadtree (registry.ctx() QuadTree*), confirmed against their hitbox. dir doesn't need to be normalized.
+RayHit raycast(const entt::registry& registry, vec2 origin, vec2 dir, float max_dist, RayMode mode = RayMode::SIGHT);
+
+bool has_line_of_sight(const entt::registry& registry, vec2 from, vec2 to);
@@ -0,0 +1,109 @@
+#include "static_layer.hpp"
+#include <algorithm>
+#include <cmath>
+
+StaticLayer& StaticLayer::getInstance() {
+    static StaticLayer instance;
+    return instance;
+}
+
+void StaticLayer::reset(int tile_cols, int tile_rows) {
+    cols = std::max(0, tile_cols) * CELLS_PER_TILE;
+    rows = std::max(0, tile_rows) * CELLS_PER_TILE;
+    wordsPerRow = (size_t(cols) + 63) / 64;
+    bits.assign(wordsPerRow * rows, 0);
+    bakedCount = 0;
+}
+
+void StaticLayer::footprint(const Hitbox& hitbox, const Motion& motion, vec2& lo, vec2& hi) {
+    float base = motion.position.y + motion.offset_to_ground.y;
+    lo = motion.position + hitbox.shape->aabb_min;
+    hi = motion.position + hitbox.shape->aabb_max;
+    // only the part of the polygon inside the depth band, collides() needs both to overlap
+    lo.y = std::max(lo.y, base - hitbox.depth);
+    hi.y = std::min(hi.y, base);
+}
+
+bool StaticLayer::cellRange(vec2 lo, vec2 hi, int& c0, int& r0, int& c1, int& r1) const {
+    if (lo.x > hi.x || lo.y > hi.y) {
+        return false; // empty footprint, the band and the polygon don't meet
+    }
+    // tile (0, 0) is centred on the origin
+    const float origin = -TILE_SIZE / 2.f;
+    c0 = int(std::floor((lo.x - origin) / CELL_SIZE));
+    c1 = int(std::floor((hi.x - origin) / CELL_SIZE));
+    r0 = int(std::floor((lo.y - origin) / CELL_SIZE));
+    r1 = int(std::floor((hi.y - origin) / CELL_SIZE));
+    if (c1 < 0 || r1 < 0 || c0 >= cols || r0 >= rows) {
+        return false;
+    }
+    c0 = std::max(c0, 0);
+    r0 = std::max(r0, 0);
+    c1 = std::min(c1, cols - 1);
+    r1 = std::min(r1, rows - 1);
+    return true;
+}
+
+void StaticLayer::bake(entt::registry& registry, entt::entity obstacle) {
+    auto& hitbox = registry.get<Hitbox>(obstacle);
+    vec2 lo, hi;
+    footprint(hitbox, registry.get<Motion>(obstacle), lo, hi);
+    hitbox.mask = 0;
+    bakedCount++;
+
+    int c0, r0, c1, r1;
+    if (!cellRange(lo, hi, c0, r0, c1, r1)) {
+        return;
+    }
+    for (int r = r0; r <= r1; ++r) {
+        uint64_t* row = &bits[size_t(r) * wordsPerRow];
+        for (int c = c0; c <= c1; ++c) {
+            row[c / 64] |= uint64_t(1) << (c % 64);
+        }
+    }
+}
+
+bool StaticLayer::blocked(vec2 lo, vec2 hi) const {
+    int c0, r0, c1, r1;
+    if (!cellRange(lo, hi, c0, r0, c1, r1)) {
+        return false;
+    }
+    // a footprint spans a handful of cells, so this is one or two words per row
+    const int w0 = c0 / 64, w1 = c1 / 64;
+    const uint64_t firstMask = ~uint64_t(0) << (c0 % 64);
+    const uint64_t lastMask = ~uint64_t(0) >> (63 - c1 % 64);
+    for (int r = r0; r <= r1; ++r) {
+        const uint64_t* row = &bits[size_t(r) * wordsPerRow];
+        for (int w = w0; w <= w1; ++w) {
+            uint64_t mask = ~uint64_t(0);
+            if (w == w0) mask &= firstMask;
+            if (w == w1) mask &= lastMask;
+            if (row[w] & mask) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+bool StaticLayer::blocked(const Hitbox& hitbox, const Motion& motion) const {
+    vec2 lo, hi;
+    footprint(hitbox, motion, lo, hi);
+    return blocked(lo, hi);
+}
+
+bool StaticLayer::sweep(const Hitbox& hitbox, const Motion& motion, float& free_until) const {
+    const vec2 start = motion.formerPosition;
+    const vec2 move = motion.position - start;
+    int steps = std::max(1, int(std::ceil(std::max(std::abs(move.x), std::abs(move.y)) / CELL_SIZE)));
+    Motion probe = motion;
+    for (int step = 0; step <= steps; ++step) {
+        float t = float(step) / steps;
+        probe.position = start + move * t;
+        if (blocked(hitbox, probe)) {
+            free_until = float(std::max(step - 1, 0)) / steps;
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "common.hpp"
+#include "hitbox.hpp"
+#include "map/tile.hpp"
+#include <entt.hpp>
+#include <vector>
+#include <cstdint>
+
+// Bit packed occupancy of the ground under trees and houses, CELLS_PER_TILE cells per tile side. Baked once when
+// MapSystem::populate_ecs creates the map's obstacles; the baked entities drop out of the broadphase (mask = 0) and
+// the player and projectiles test their footprint against the bits instead.
+// A footprint is the hitbox's x extent by the part of its y extent inside its depth band (depth up from its base).
+// collides() needs both the bands and the polygons to overlap, so two footprints overlapping means it would have
+// passed too; it can pass a little further than the footprints do when one limit comes from the band and the other
+// from the polygon (player vs forest tree: blocked while the player is 62 to 131 px below the tree's position, the
+// old check went to 138). Cells round outwards by at most one cell.
+class StaticLayer {
+public:
+    static constexpr int CELLS_PER_TILE = 4;
+    static constexpr float CELL_SIZE = float(TILE_SIZE) / CELLS_PER_TILE;
+
+    static StaticLayer& getInstance();
+
+    // clears the layer and sizes it for a map of tile_cols x tile_rows tiles
+    void reset(int tile_cols, int tile_rows);
+    // marks the obstacle's footprint and takes it out of the broadphase
+    void bake(entt::registry& registry, entt::entity obstacle);
+
+    // is any cell in the world box [lo, hi] set?
+    bool blocked(vec2 lo, vec2 hi) const;
+    bool blocked(const Hitbox& hitbox, const Motion& motion) const;
+    // blocked() along the move from formerPosition to position, sampled at least once per cell. free_until is the
+    // last sample before the first blocked one, as a fraction of the move (0 if it starts blocked).
+    bool sweep(const Hitbox& hitbox, const Motion& motion, float& free_until) const;
+
+    static void footprint(const Hitbox& hitbox, const Motion& motion, vec2& lo, vec2& hi);
+
+    size_t baked() const { return bakedCount; }
+private:
+    StaticLayer() = default;
+    StaticLayer(const StaticLayer&) = delete;
+    StaticLayer& operator=(const StaticLayer&) = delete;
+
+    int cols = 0, rows = 0;
+    size_t wordsPerRow = 0;
+    std::vector<uint64_t> bits; // row major, bit c % 64 of word c / 64 in a row
+    size_t bakedCount = 0;
+
+    // cell range covered by [lo, hi], false if it misses the map
+    bool cellRange(vec2 lo, vec2 hi, int& c0, int& r0, int& c1, int& r1) const;
+};
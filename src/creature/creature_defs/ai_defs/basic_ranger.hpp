@@ -9,6 +9,7 @@
 #include "ai/state_machine/ai_state.hpp"
 #include <cmath>
 #include <ai/ai_component.hpp>
+#include "collision/raycast.hpp"
 
 inline bool shouldTransitionToChase(float diff, const AIConfig& config) {
     return (diff < config.detectionRange) && (diff > config.attackRange) && (diff > config.retreatRange);
@@ -26,6 +27,11 @@ inline bool shouldTransitionToRetreat(float diff, const AIConfig& config) {
     return (diff < config.retreatRange);
 }
 
+// no point shooting into a tree, only checked once the cheaper range checks pass
+inline bool hasClearShot(const entt::registry& reg, const Motion& motion, const Motion& playerMotion) {
+    return has_line_of_sight(reg, motion.position + motion.offset_to_ground, playerMotion.position + playerMotion.offset_to_ground);
+}
+
 inline const TransitionTable& getBasicRangerTransitionTable() {
     static TransitionTable rangedTransitions;
     if (rangedTransitions.empty()) {
@@ -57,7 +63,7 @@ inline const TransitionTable& getBasicRangerTransitionTable() {
                 
                 auto& aiComp = reg.get<AIComponent>(entity);
                 const RangeAIConfig& rangeConfig = static_cast<const RangeAIConfig&>(config);
-                return shouldTransitionToAttack(dist, rangeConfig, aiComp.attackCooldownTimer);
+                return shouldTransitionToAttack(dist, rangeConfig, aiComp.attackCooldownTimer) && hasClearShot(reg, motion, playerMotion);
             }
         });
 
@@ -116,7 +122,7 @@ inline const TransitionTable& getBasicRangerTransitionTable() {
 
                 auto& aiComp = reg.get<AIComponent>(entity);
                 const RangeAIConfig& rangeConfig = static_cast<const RangeAIConfig&>(config);
-                return shouldTransitionToAttack(dist, rangeConfig, aiComp.attackCooldownTimer);
+                return shouldTransitionToAttack(dist, rangeConfig, aiComp.attackCooldownTimer) && hasClearShot(reg, motion, playerMotion);
             }
         });
 
@@ -133,7 +139,7 @@ inline const TransitionTable& getBasicRangerTransitionTable() {
                 float dist = length(playerMotion.position - motion.position);
                 auto& aiComp = reg.get<AIComponent>(entity);
                 const RangeAIConfig& rangeConfig = static_cast<const RangeAIConfig&>(config);
-                return currState->isStateComplete() && shouldTransitionToAttack(dist, rangeConfig, aiComp.attackCooldownTimer);
+                return currState->isStateComplete() && shouldTransitionToAttack(dist, rangeConfig, aiComp.attackCooldownTimer) && hasClearShot(reg, motion, playerMotion);
             }
         });
 
@@ -37,7 +37,7 @@ void CreatureDefinitionData::initializeRenderingInfo() {
 
 void CreatureDefinitionData::initializePhysicsInfo() {
     physicsInfo.offset_to_ground = {0, 0};
-    physicsInfo.hitbox.pts.clear();
+    physicsInfo.hitbox.shape = empty_shape();
     physicsInfo.hitbox.depth = 0;
 }
 
@@ -41,10 +41,10 @@ protected:
         physicsInfo.offset_to_ground = { 0, physicsInfo.scale.y / 2.f };
         float w = physicsInfo.scale.x;
         float h = physicsInfo.scale.y;
-        physicsInfo.hitbox.pts = {
+        physicsInfo.hitbox.shape = intern_shape({
             {w * -0.5f, h * -0.5f}, {w * 0.5f, h * -0.5f},
             {w * 0.5f, h * 0.5f},   {w * -0.5f, h * 0.5f}
-        };
+        });
         physicsInfo.hitbox.depth = 50;
     }
 
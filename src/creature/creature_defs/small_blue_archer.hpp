@@ -66,10 +66,10 @@ protected:
         physicsInfo.offset_to_ground = {0, renderingInfo.scale.y / 4.f * 0.8f};
         float w = renderingInfo.scale.x * 0.4f;
         float h = renderingInfo.scale.y * 0.5f;
-        physicsInfo.hitbox.pts = {
+        physicsInfo.hitbox.shape = intern_shape({
             {w * -0.5f, h * -0.5f}, {w * 0.5f, h * -0.5f},
             {w * 0.5f, h * 0.5f},   {w * -0.5f, h * 0.5f}
-        };
+        });
         physicsInfo.hitbox.depth = 60;
     }
 
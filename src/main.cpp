@@ -12,6 +12,7 @@
 #include "world_system.hpp"
 #include "camera_system.hpp"
 #include "ai_system.hpp"
+#include "activity_system.hpp"
 #include "collision/collision_system.hpp"
 #include "physics_system.hpp"
 #include "music_system.hpp"
@@ -23,15 +24,57 @@
 #include "animation_system.hpp"
 #include "player/player_system.hpp"
 #include <ai/ai_initializer.hpp>
+#include <ai/path_bench.hpp>
+#include <ai/path_finder.hpp>
+#include <ai/path_service.hpp>
 #include <ai/state_machine/state_factory.hpp>
 #include "quadtree/quadtree.hpp"
+#include "quadtree/spatial_grid.hpp"
+#include "quadtree/quadtree_bench.hpp"
 
 #include <iomanip>
 using Clock = std::chrono::high_resolution_clock;
 
 // Entry point
-int main()
+int main(int argc, char* argv[])
 {
+	// --collision-threads N splits the narrowphase over N threads
+	size_t collisionThreads = 1;
+	// --tick-hz N runs the simulation N times a second, whatever the frame rate
+	int tickHz = 60;
+	// --path-bench N times N random path queries on a fresh map and exits
+	int pathBenchQueries = 0;
+	// --quadtree-bench N times N window sized queries through each QuadTree query API and exits
+	int quadTreeBenchQueries = 0;
+	// --collision-bench N times the narrowphase on N objects at 1, 2, 4 and 8 threads and exits
+	int collisionBenchObjects = 0;
+	// --path-mode jps makes mobs path with jump point search instead of A*
+	// --path-threads N searches mob paths on N threads, 0 runs them on the main thread
+	size_t pathThreads = 1;
+	for (int i = 1; i + 1 < argc; i++) {
+		if (std::string(argv[i]) == "--collision-threads") {
+			collisionThreads = std::max(1, std::atoi(argv[i + 1]));
+		}
+		else if (std::string(argv[i]) == "--tick-hz") {
+			tickHz = std::clamp(std::atoi(argv[i + 1]), 10, 240);
+		}
+		else if (std::string(argv[i]) == "--path-bench") {
+			pathBenchQueries = std::max(0, std::atoi(argv[i + 1]));
+		}
+		else if (std::string(argv[i]) == "--quadtree-bench") {
+			quadTreeBenchQueries = std::max(0, std::atoi(argv[i + 1]));
+		}
+		else if (std::string(argv[i]) == "--collision-bench") {
+			collisionBenchObjects = std::max(0, std::atoi(argv[i + 1]));
+		}
+		else if (std::string(argv[i]) == "--path-threads") {
+			pathThreads = std::max(0, std::atoi(argv[i + 1]));
+		}
+		else if (std::string(argv[i]) == "--path-mode") {
+			Pathfinder::setMode(std::string(argv[i + 1]) == "jps" ? PathMode::JUMP_POINT : PathMode::ASTAR);
+		}
+	}
+
 	// TOGGLE this if you don't want a new map every time...
 	int mapWidth = 500, mapHeight = 500; 
 	if (true) {
@@ -50,6 +93,14 @@ int main()
 	
 	// initialize the main systems
 	MapSystem::init(reg);
+	if (pathBenchQueries > 0) {
+		runPathBenchmark(pathBenchQueries, 1);
+		return EXIT_SUCCESS;
+	}
+	if (quadTreeBenchQueries > 0) {
+		runQuadTreeBenchmark(quadTreeBenchQueries, 1);
+		return EXIT_SUCCESS;
+	}
 
 	// spawn system needs to be initialized after the map system
 	SpawnSystem::initialize(reg);
@@ -57,14 +108,22 @@ int main()
 
 	// assets and constants
 	initializeAIStates(g_stateFactory);
-	// QuadTree
-	QuadTree quadTree((mapWidth / 2) * 16.f, (mapHeight / 2) * 16.f, mapWidth, mapHeight);
+	PathService::getInstance().start(pathThreads);
+	// QuadTree, padded by a few tiles so objects on the map border still fall inside the root.
+	// Loose, so trees/houses straddling a split line are stored once and always found
+	QuadTreeConfig quadTreeConfig;
+	quadTreeConfig.looseness = 2.f;
+	QuadTree quadTree((mapWidth / 2) * 16.f, (mapHeight / 2) * 16.f, (mapWidth + 32) * 16.f, (mapHeight + 32) * 16.f, quadTreeConfig);
+	reg.ctx().emplace<QuadTree*>(&quadTree); // for raycasts from the AI states
+	// mobs, projectiles and slashes, rebuilt every frame after physics (targeting) and before collisions
+	SpatialGrid dynamicGrid((mapWidth / 2) * 16.f, (mapHeight / 2) * 16.f, (mapWidth + 32) * 16.f, (mapHeight + 32) * 16.f, 64.f);
 	// global systems
 	FlagSystem flag_system(reg); 
 	PhysicsSystem physics_system(reg, flag_system);
-	WorldSystem   world_system(reg, physics_system, flag_system, quadTree);
-	RenderSystem  renderer_system(reg, quadTree);
+	WorldSystem   world_system(reg, physics_system, flag_system, quadTree, dynamicGrid);
+	RenderSystem  renderer_system(reg, quadTree, dynamicGrid);
 	AISystem ai_system(reg);
+	ActivitySystem activity_system(reg); // what is far enough away to sleep, before anything that skips it
 	CameraSystem camera_system(reg);
 
 	
@@ -76,7 +135,12 @@ int main()
 	
 
 
-	CollisionSystem collision_system(reg, world_system, physics_system, quadTree, spawn_system, flag_system);
+	CollisionSystem collision_system(reg, world_system, physics_system, quadTree, dynamicGrid, spawn_system, flag_system);
+	collision_system.setThreads(collisionThreads);
+	if (collisionBenchObjects > 0) {
+		collision_system.runBenchmark(collisionBenchObjects, 1);
+		return EXIT_SUCCESS;
+	}
 
 	// initialize window
 	GLFWwindow* window = world_system.create_window();
@@ -98,8 +162,12 @@ int main()
 	//renderer_system.initTree(); 
 	//collision_system.initTree(mapWidth, mapHeight);
 	
-	// variable timestep loop
+	// fixed timestep loop, rendering interpolates between the last two ticks
 	auto t = Clock::now();
+	const float tick_ms = 1000.f / tickHz;
+	const int maxSubsteps = 5; // after a long hitch the game slows down rather than spiralling
+	float accumulator_ms = 0.f;
+	MotionInterpolator interpolator;
 
 	int num_frames = 0;
 	float num_s = 0.f;
@@ -136,26 +204,43 @@ int main()
 
 		// Make sure collision_system is called before collision is after physics will mark impossible movements in a set
 		if (!flag_system.is_paused) {
-			time_exe<int>("AI  ", [&]() {ai_system.step(elapsed_ms); return 0;}); // AI system should be before physics system
-			time_exe<int>("PHYS", [&](){physics_system.step(elapsed_ms); return 0;});
-			time_exe<int>("WORL", [&](){world_system.step(elapsed_ms); return 0;});
-			time_exe<int>("PLAY", [&](){playerSystem.update(elapsed_ms); return 0;});
-			time_exe<int>("ANIM", [&](){animationSystem.update(elapsed_ms); return 0;});
-			if (flag_system.isDone()) {
-				time_exe<int>("SPAW", [&](){spawn_system.update(elapsed_ms); return 0;});	
+			accumulator_ms += elapsed_ms;
+			int substeps = 0;
+			while (accumulator_ms >= tick_ms && substeps < maxSubsteps) {
+				time_exe<int>("ACTV", [&](){activity_system.step(tick_ms); return 0;});
+				time_exe<int>("AI  ", [&]() {ai_system.step(tick_ms); return 0;}); // AI system should be before physics system
+				time_exe<int>("PHYS", [&](){physics_system.step(tick_ms); return 0;});
+				time_exe<int>("GRID", [&](){dynamicGrid.rebuild(reg); return 0;});
+				time_exe<int>("WORL", [&](){world_system.step(tick_ms); return 0;});
+				time_exe<int>("PLAY", [&](){playerSystem.update(tick_ms); return 0;});
+				time_exe<int>("ANIM", [&](){animationSystem.update(tick_ms); return 0;});
+				if (flag_system.isDone()) {
+					time_exe<int>("SPAW", [&](){spawn_system.update(tick_ms); return 0;});	
+				}
+				time_exe<int>("GRI2", [&](){dynamicGrid.rebuild(reg); return 0;}); // picks up this tick's spawns/slashes
+				time_exe<int>("COLL", [&](){collision_system.step(tick_ms); return 0;});
+				accumulator_ms -= tick_ms;
+				substeps++;
 			}
-			time_exe<int>("COLL", [&](){collision_system.step(elapsed_ms); return 0;});
-			time_exe<int>("CAME", [&](){camera_system.step(elapsed_ms); return 0;});
-			
+			if (substeps == maxSubsteps) {
+				accumulator_ms = std::min(accumulator_ms, tick_ms);
+			}
+			debug_printf(DebugType::TIME, "%d ticks this frame\n", substeps);
 		}
 		world_system.step_buttons(elapsed_ms);
 
 		time_exe<int>("FLAG", [&](){flag_system.step(elapsed_ms); return 0;});
+		interpolator.apply(reg, accumulator_ms / tick_ms, tick_ms);
+		if (!flag_system.is_paused) {
+			time_exe<int>("CAME", [&](){camera_system.step(elapsed_ms); return 0;});
+		}
 		time_exe<int>("REND", [&](){renderer_system.draw(); return 0;});
+		interpolator.restore(reg);
 		debug_printf(DebugType::TIME, "-----------------------\n");
 		set_debug(DebugType::TIME, false);
 	}
 
+	PathService::getInstance().stop();
 	return EXIT_SUCCESS;
 }
 
@@ -1,6 +1,8 @@
 #include "map_system.hpp"
 #include "world_init.hpp"
 #include "music_system.hpp"
+#include "collision/static_layer.hpp"
+#include "ai/path_finder.hpp"
 
 /*
 --------------------
@@ -45,6 +47,7 @@ Public methods
 
 void MapSystem::init(entt::registry& reg) {
     loadMap();
+    Pathfinder::loadMap();
     createBackground(reg, map_width, map_height, TILE_SIZE);
     initBossSpawnIndices();
 };
@@ -73,6 +76,8 @@ vec2 MapSystem::populate_ecs(
     vec2& s_pos
 ) {
     vec2 spawn_pos = {0, 0};
+    StaticLayer& static_layer = StaticLayer::getInstance();
+    static_layer.reset(map_width, map_height);
 
     for (int i = 0; i < map_height; i++) {
         for (int j = 0; j < map_width; j++) {
@@ -86,16 +91,16 @@ vec2 MapSystem::populate_ecs(
                     p_pos = map_pos;
                     break;
                 case Decoration::TREE:
-                    createTree(
+                    static_layer.bake(reg, createTree(
                         reg, map_pos,
                         get_biome(game_map[i][j]), get_terrain(game_map[i][j])
-                    );
+                    ));
                     break;
                 case Decoration::SHIP:
                     s_pos = map_pos;
                     break;
                 case Decoration::HOUSE:
-                    createHouse(reg, map_pos, get_biome(game_map[i][j]));
+                    static_layer.bake(reg, createHouse(reg, map_pos, get_biome(game_map[i][j])));
                     break;
                 default:
                     break;
@@ -244,6 +249,49 @@ bool MapSystem::walkable_tile(Tile tile) {
         );
 };
 
+bool MapSystem::blocks_sight(Tile tile) {
+    Decoration decoration = get_decoration(tile);
+    return decoration == Decoration::TREE || decoration == Decoration::BARRIER ||
+        decoration == Decoration::HOUSE || decoration == Decoration::SHIP;
+}
+
+bool MapSystem::raycast_tiles(vec2 origin, vec2 dir, float max_dist, bool (*blocks)(Tile), float& hit_dist, ivec2& hit_tile) {
+    // get_tile_indices rounds, so shift by half a tile to get tiles spanning [i, i + 1)
+    vec2 start = origin / float(TILE_SIZE) + vec2(0.5f);
+    ivec2 tile = ivec2(std::floor(start.x), std::floor(start.y));
+    ivec2 step = ivec2(dir.x > 0 ? 1 : -1, dir.y > 0 ? 1 : -1);
+
+    // distance (in pixels) to the next column/row crossing, and between crossings
+    const float inf = std::numeric_limits<float>::infinity();
+    vec2 delta = vec2(
+        dir.x != 0 ? TILE_SIZE / std::abs(dir.x) : inf,
+        dir.y != 0 ? TILE_SIZE / std::abs(dir.y) : inf
+    );
+    vec2 next = vec2(
+        dir.x != 0 ? (dir.x > 0 ? tile.x + 1 - start.x : start.x - tile.x) * delta.x : inf,
+        dir.y != 0 ? (dir.y > 0 ? tile.y + 1 - start.y : start.y - tile.y) * delta.y : inf
+    );
+
+    while (true) {
+        float t;
+        if (next.x < next.y) {
+            t = next.x;
+            tile.x += step.x;
+            next.x += delta.x;
+        } else {
+            t = next.y;
+            tile.y += step.y;
+            next.y += delta.y;
+        }
+        if (t > max_dist) return false;
+        if (blocks(get_tile_type_by_indices(tile.x, tile.y))) {
+            hit_dist = t;
+            hit_tile = tile;
+            return true;
+        }
+    }
+}
+
 Biome MapSystem::get_biome_by_indices(ivec2 tile_indices) {
     return get_biome(get_tile_type_by_indices(tile_indices.x, tile_indices.y));
 };
@@ -29,6 +29,12 @@ public:
     static vec2 get_tile_center_pos(vec2 tile_indices);
 
     static bool walkable_tile(Tile tile);
+    // trees, barriers, houses and the ship block sight, water doesn't
+    static bool blocks_sight(Tile tile);
+
+    // Walks the tiles along origin + dir * t (dir normalized) with a DDA and stops at the first tile that blocks(tile).
+    // The tile the ray starts in is skipped. Returns whether something was hit within max_dist.
+    static bool raycast_tiles(vec2 origin, vec2 dir, float max_dist, bool (*blocks)(Tile), float& hit_dist, ivec2& hit_tile);
 
     static Biome get_biome_by_indices(ivec2 tile_indices);
 
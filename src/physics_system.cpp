@@ -1,6 +1,11 @@
 #include "physics_system.hpp"
 #include "ui_system.hpp"
 
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define PHYSICS_SSE 1
+#endif
+
 PhysicsSystem::PhysicsSystem(entt::registry& reg, FlagSystem& flag_system):
 	registry(reg),
     flag_system(flag_system)
@@ -127,7 +132,6 @@ void PhysicsSystem::dash() {
 void PhysicsSystem::step(float elapsed_ms) {
     float elapsed_s = elapsed_ms / 1000;
     updateVelocity(elapsed_s);
-    stepAcceleration(elapsed_s); 
     updatePlayerState(elapsed_s); 
 }
 
@@ -148,58 +152,146 @@ void PhysicsSystem::updatePlayerState(float elapsed_s) {
 
 }
 
-// always bring it back to 0, maybe change the way it reverts to 0. 
-void PhysicsSystem::stepAcceleration(float elapsed_s) {
-    auto view = registry.view<Motion>();
-    for (auto entity : view) {
-        auto& motion = view.get<Motion>(entity);
+void PhysicsSystem::MotionLanes::resize(size_t n) {
+    motions.resize(n);
+    px.resize(n); py.resize(n);
+    vx.resize(n); vy.resize(n);
+    ax.resize(n); ay.resize(n);
+}
 
-        float dampingCoefficient = 2.0f; 
-        float dampingFactor = exp(-elapsed_s * dampingCoefficient);
-        motion.acceleration *= dampingFactor;
+void PhysicsSystem::gatherLanes() {
+    auto& dynamic = registry.storage<Dynamic>();
+    const entt::entity* entities = dynamic.data();
+    lanes.resize(dynamic.size());
+    for (size_t i = 0; i < dynamic.size(); ++i) {
+        Motion* motion = registry.try_get<Motion>(entities[i]);
+        lanes.motions[i] = motion;
+        Motion none;
+        const Motion& m = motion ? *motion : none;
+        lanes.px[i] = m.position.x;     lanes.py[i] = m.position.y;
+        lanes.vx[i] = m.velocity.x;     lanes.vy[i] = m.velocity.y;
+        lanes.ax[i] = m.acceleration.x; lanes.ay[i] = m.acceleration.y;
+    }
+}
 
-        // if magnitude is small enough 0 it out
-        if (glm::length(motion.acceleration) < 2.f) {
-            motion.acceleration = { 0.0f, 0.0f };
-        }
+namespace {
+// acceleration change, or cap the current velocity at MAX_SPEED if it would go over. Then damp the acceleration
+// and 0 it out if the magnitude is small enough
+inline void integrateLane(float& vx, float& vy, float& ax, float& ay, float dampingFactor) {
+    float nx = vx + ax;
+    float ny = vy + ay;
+    if (nx * nx + ny * ny > MAX_SPEED * MAX_SPEED) {
+        float cap = MAX_SPEED / std::sqrt(vx * vx + vy * vy);
+        vx *= cap;
+        vy *= cap;
+    }
+    else {
+        vx = nx;
+        vy = ny;
+    }
+    ax *= dampingFactor;
+    ay *= dampingFactor;
+    if (ax * ax + ay * ay < 4.f) {
+        ax = 0.f;
+        ay = 0.f;
     }
 }
+}
 
+void PhysicsSystem::integrateLanes(float elapsed_s) {
+    const size_t n = lanes.motions.size();
+    float* px = lanes.px.data(); float* py = lanes.py.data();
+    float* vx = lanes.vx.data(); float* vy = lanes.vy.data();
+    float* ax = lanes.ax.data(); float* ay = lanes.ay.data();
 
-void PhysicsSystem::updateVelocity(float elapsed_s) {
-    auto players = registry.view<Motion>();
-    for (auto entity : players) {
-        auto& motion = registry.get<Motion>(entity);
-        motion.formerPosition = motion.position;
-        if (glm::length(motion.velocity + motion.acceleration) > MAX_SPEED) {
-            motion.velocity = glm::normalize(motion.velocity) * MAX_SPEED;
-        }
-        else {
-            motion.velocity += motion.acceleration; // acceleration change
-        }
-        if (registry.all_of<MarkedCollision>(entity)) {
-			motion.velocity = registry.get<MarkedCollision>(entity).velocity;
-        } 
-        motion.position += motion.velocity * elapsed_s;
-        if (registry.all_of<Player>(entity)) {
-            UISystem::equipItem(registry, motion, flag_system);
+    // always bring acceleration back to 0, maybe change the way it reverts to 0.
+    const float dampingCoefficient = 2.0f;
+    const float dampingFactor = exp(-elapsed_s * dampingCoefficient);
+    size_t i = 0;
+#ifdef PHYSICS_SSE
+    // same as integrateLane, 4 lanes at a time with selects instead of branches
+    const __m128 maxSpeed = _mm_set1_ps(MAX_SPEED);
+    const __m128 maxSpeed2 = _mm_set1_ps(MAX_SPEED * MAX_SPEED);
+    const __m128 damping = _mm_set1_ps(dampingFactor);
+    const __m128 minAcc2 = _mm_set1_ps(4.f);
+    for (; i + 4 <= n; i += 4) {
+        __m128 vx4 = _mm_loadu_ps(vx + i), vy4 = _mm_loadu_ps(vy + i);
+        __m128 ax4 = _mm_loadu_ps(ax + i), ay4 = _mm_loadu_ps(ay + i);
+        __m128 nx = _mm_add_ps(vx4, ax4);
+        __m128 ny = _mm_add_ps(vy4, ay4);
+        __m128 over = _mm_cmpgt_ps(_mm_add_ps(_mm_mul_ps(nx, nx), _mm_mul_ps(ny, ny)), maxSpeed2);
+        __m128 cap = _mm_div_ps(maxSpeed, _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(vx4, vx4), _mm_mul_ps(vy4, vy4))));
+        vx4 = _mm_or_ps(_mm_and_ps(over, _mm_mul_ps(vx4, cap)), _mm_andnot_ps(over, nx));
+        vy4 = _mm_or_ps(_mm_and_ps(over, _mm_mul_ps(vy4, cap)), _mm_andnot_ps(over, ny));
+        ax4 = _mm_mul_ps(ax4, damping);
+        ay4 = _mm_mul_ps(ay4, damping);
+        __m128 keep = _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(ax4, ax4), _mm_mul_ps(ay4, ay4)), minAcc2);
+        _mm_storeu_ps(vx + i, vx4);
+        _mm_storeu_ps(vy + i, vy4);
+        _mm_storeu_ps(ax + i, _mm_and_ps(keep, ax4));
+        _mm_storeu_ps(ay + i, _mm_and_ps(keep, ay4));
+    }
+#endif
+    for (; i < n; ++i) {
+        integrateLane(vx[i], vy[i], ax[i], ay[i], dampingFactor);
+    }
+
+    // collisions that forced a velocity win over the above
+    auto& dynamic = registry.storage<Dynamic>();
+    for (auto&& [entity, marked] : registry.view<MarkedCollision>().each()) {
+        if (dynamic.contains(entity)) {
+            size_t i = dynamic.index(entity);
+            vx[i] = marked.velocity.x;
+            vy[i] = marked.velocity.y;
         }
-        if (registry.all_of<Mob>(entity)) {
-            UISystem::updateMobHealthBar(registry, entity, false);
+    }
+
+    // plain enough that the compiler vectorizes it
+    for (size_t i = 0; i < n; ++i) {
+        px[i] += vx[i] * elapsed_s;
+        py[i] += vy[i] * elapsed_s;
+    }
+}
+
+void PhysicsSystem::scatterLanes() {
+    const entt::entity* entities = registry.storage<Dynamic>().data();
+    for (size_t i = 0; i < lanes.motions.size(); ++i) {
+        Motion* motion = lanes.motions[i];
+        if (!motion) {
+            continue;
         }
-        if (registry.any_of<HomingMissile>(entity)) {
-            auto& missile_postion = registry.get<Motion>(entity).position;
-            if (!registry.valid(registry.get<HomingMissile>(entity).target)) continue;
-            auto& target_entity = registry.get<HomingMissile>(entity).target;
-            auto& target_position = registry.get<Motion>(target_entity).position;
-            vec2 current_direction = normalize(motion.velocity);
-            vec2 mob_direction = normalize(target_position - missile_postion);
-            motion.velocity = (current_direction + (mob_direction - current_direction) * elapsed_s * 5.f) * PROJECTILE_SPEED;
-            motion.angle = atan2(motion.velocity.y, motion.velocity.x) * (180.0f / M_PI) + 90.0f;
+        motion->formerPosition = motion->position;
+        motion->velocity = { lanes.vx[i], lanes.vy[i] };
+        motion->acceleration = { lanes.ax[i], lanes.ay[i] };
+        motion->position = { lanes.px[i], lanes.py[i] };
+        if (motion->position != motion->formerPosition) {
+            registry.patch<Motion>(entities[i]); // lets the quadtree re-bucket moved objects
         }
     }
 }
 
+// Only Dynamic entities are integrated, everything else (trees, houses, UI) isn't touched. The per type work runs
+// after as its own pass over just the entities it is for.
+void PhysicsSystem::updateVelocity(float elapsed_s) {
+    gatherLanes();
+    integrateLanes(elapsed_s);
+    scatterLanes();
+
+    for (auto entity : registry.view<Player, Motion>()) {
+        UISystem::equipItem(registry, registry.get<Motion>(entity), flag_system);
+    }
+    UISystem::updateMobHealthBars(registry);
+    for (auto&& [entity, missile, motion] : registry.view<HomingMissile, Motion>().each()) {
+        if (!registry.valid(missile.target)) continue;
+        auto& missile_postion = motion.position;
+        auto& target_position = registry.get<Motion>(missile.target).position;
+        vec2 current_direction = normalize(motion.velocity);
+        vec2 mob_direction = normalize(target_position - missile_postion);
+        motion.velocity = (current_direction + (mob_direction - current_direction) * elapsed_s * 5.f) * PROJECTILE_SPEED;
+        motion.angle = atan2(motion.velocity.y, motion.velocity.x) * (180.0f / M_PI) + 90.0f;
+    }
+}
+
 
 // Should move both away. 
 void PhysicsSystem::suppress(entt::entity& e1, entt::entity& e2) {
@@ -232,3 +324,25 @@ vec2 PhysicsSystem::getDirection(entt::entity e1, entt::entity e2) {
     }
     return direction; 
 }
+
+void MotionInterpolator::apply(entt::registry& registry, float alpha, float tick_ms) {
+    saved.clear();
+    const float maxStep = 2.f * MAX_SPEED * tick_ms / 1000.f;
+    for (auto&& [entity, motion] : registry.view<Dynamic, Motion>().each()) {
+        vec2 from = motion.formerPosition;
+        if (std::isnan(from.x) || std::isnan(from.y) || from == motion.position || glm::length(motion.position - from) > maxStep) {
+            continue;
+        }
+        saved.emplace_back(entity, motion.position);
+        motion.position = from + (motion.position - from) * alpha;
+    }
+}
+
+void MotionInterpolator::restore(entt::registry& registry) {
+    for (auto& [entity, position] : saved) {
+        if (registry.valid(entity)) {
+            registry.get<Motion>(entity).position = position;
+        }
+    }
+    saved.clear();
+}
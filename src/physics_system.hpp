@@ -26,9 +26,32 @@ private:
     entt::registry& registry;
     FlagSystem& flag_system;
 
+    // the Dynamic Motions gathered side by side each tick, so the integration passes read straight through them
+    // (and vectorize). slot i is the i-th entity of the Dynamic storage, motions[i] is null if it has no Motion.
+    struct MotionLanes {
+        std::vector<Motion*> motions;
+        std::vector<float> px, py, vx, vy, ax, ay;
+        void resize(size_t n);
+    };
+    MotionLanes lanes;
+
     void updateVelocity(float elapsed_s); 
-    void stepAcceleration(float elapsed_s);
+    void gatherLanes();
+    void integrateLanes(float elapsed_s);
+    void scatterLanes();
     void updatePlayerState(float elapsed_s);
     vec2 getDirection(entt::entity e1, entt::entity e2); 
 
+};
+
+// The simulation runs in fixed ticks, so a frame usually lands part way into the next one. apply() moves every Dynamic
+// Motion to alpha of the way from where the last tick started (formerPosition) to where it ended, for the camera and
+// renderer; restore() puts the simulated positions back before the next tick. Anything that jumped further than it
+// could move in a tick (respawns, teleports) is drawn where it is.
+class MotionInterpolator {
+public:
+    void apply(entt::registry& registry, float alpha, float tick_ms);
+    void restore(entt::registry& registry);
+private:
+    std::vector<std::pair<entt::entity, vec2>> saved;
 };
\ No newline at end of file
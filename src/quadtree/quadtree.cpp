@@ -1,129 +1,393 @@
 #include "quadtree.hpp"
 
+QuadTree::Box QuadTree::entityBox(entt::entity entity, const entt::registry& registry) {
+    const auto& motion = registry.get<Motion>(entity);
+    return Box{ motion.position.x - motion.scale.x / 2.f, motion.position.y - motion.scale.y / 2.f,
+        motion.position.x + motion.scale.x / 2.f, motion.position.y + motion.scale.y / 2.f };
+}
+
+QuadTree::QuadTree(float x, float y, float width, float height, QuadTreeConfig config) : bounds(x, y, width, height) {
+    configure(config);
+}
+
+void QuadTree::configure(const QuadTreeConfig& newConfig) {
+    config = newConfig;
+    config.maxObjects = std::max(1, config.maxObjects);
+    config.maxLevels = std::clamp(config.maxLevels, 0, LEVEL_CAP);
+    config.looseness = std::max(1.f, config.looseness);
+    clear();
+    if (connectedRegistry != nullptr) {
+        initTree(*connectedRegistry);
+    }
+}
+
+QuadTree::~QuadTree() {
+    disconnect();
+}
 
 void QuadTree::initTree(entt::registry& registry) {
-    quadTree = new QuadTree(400.0f * 16.f, 400.0f * 16.f, 800 * 16.f, 800 * 16.f);
-    auto view = registry.view<Motion, Hitbox>(entt::exclude<Player, UIShip, Item, Title, TextData>); //currently reloads entire tree per frame
-    for (auto entity : view) { 
-        quadTree->insert(entity, registry);
+    clear();
+    // mobs, projectiles and slashes move every frame, so they stay out of the tree
+    auto view = registry.view<Motion, Hitbox>(entt::exclude<Player, UIShip, Item, Title, TextData, Mob, Projectile, Slash>);
+    payload.reserve(view.size_hint() + BUCKET_SIZE);
+    for (auto entity : view) {
+        insert(entity, registry);
+    }
+    connect(registry);
+}
+
+void QuadTree::connect(entt::registry& registry) {
+    disconnect();
+    registry.on_update<Motion>().connect<&QuadTree::onMotionUpdate>(*this);
+    registry.on_destroy<Motion>().connect<&QuadTree::onMotionDestroy>(*this);
+    connectedRegistry = &registry;
+}
+
+void QuadTree::disconnect() {
+    if (connectedRegistry == nullptr) {
+        return;
     }
+    connectedRegistry->on_update<Motion>().disconnect<&QuadTree::onMotionUpdate>(*this);
+    connectedRegistry->on_destroy<Motion>().disconnect<&QuadTree::onMotionDestroy>(*this);
+    connectedRegistry = nullptr;
+}
 
+void QuadTree::onMotionUpdate(entt::registry& registry, entt::entity entity) {
+    update(entity, registry);
+}
 
+void QuadTree::onMotionDestroy(entt::registry& registry, entt::entity entity) {
+    remove(entity, registry);
 }
 
-QuadTree* QuadTree::insert(entt::entity entity, const entt::registry& registry) {
-    if (children[0] != nullptr) {
-        return insertIntoChildren(entity, registry);
+// De-interleaves the Morton code into the cell's column/row at its level
+Quad QuadTree::nodeBounds(int32_t index) const {
+    const Node& node = nodes[index];
+    uint32_t col = 0, row = 0;
+    for (int i = 0; i < node.level; ++i) {
+        col |= ((node.code >> (2 * i)) & 1u) << i;
+        row |= ((node.code >> (2 * i + 1)) & 1u) << i;
     }
+    float cells = float(1u << node.level);
+    float width = bounds.width / cells;
+    float height = bounds.height / cells;
+    return Quad(bounds.x - bounds.width / 2 + (col + 0.5f) * width,
+                bounds.y - bounds.height / 2 + (row + 0.5f) * height, width, height);
+}
 
-    objects.push_back(entity);
+Quad QuadTree::looseBounds(int32_t index) const {
+    Quad quad = nodeBounds(index);
+    quad.width *= config.looseness;
+    quad.height *= config.looseness;
+    return quad;
+}
 
-    if (objects.size() > MAX_OBJECTS && level < MAX_LEVELS) {
-        if (children[0] == nullptr) {
-            subdivide();
-        }
+int32_t QuadTree::allocateBucket() {
+    int32_t bucket;
+    if (!freeBuckets.empty()) {
+        bucket = freeBuckets.back();
+        freeBuckets.pop_back();
+    } else {
+        bucket = int32_t(bucketNext.size());
+        bucketNext.push_back(NONE);
+        payload.resize(payload.size() + BUCKET_SIZE);
+        minX.resize(payload.size());
+        minY.resize(payload.size());
+        maxX.resize(payload.size());
+        maxY.resize(payload.size());
+    }
+    bucketNext[bucket] = NONE;
+    return bucket;
+}
 
-        auto tempObjects = objects;
-        objects.clear();
-        for (auto entity : tempObjects) {
-            insertIntoChildren(entity, registry);
+size_t QuadTree::findSlot(int32_t index, entt::entity entity) const {
+    uint32_t remaining = nodes[index].count;
+    for (int32_t bucket = nodes[index].firstBucket; bucket != NONE; bucket = bucketNext[bucket]) {
+        uint32_t n = std::min<uint32_t>(remaining, BUCKET_SIZE);
+        size_t base = size_t(bucket) * BUCKET_SIZE;
+        for (uint32_t i = 0; i < n; ++i) {
+            if (payload[base + i] == entity) {
+                return base + i;
+            }
         }
+        remaining -= n;
     }
-    return this; 
+    return SIZE_MAX;
 }
 
-void QuadTree::subdivide() {
-    float subWidth = bounds.width / 2;
-    float subHeight = bounds.height / 2;
-
-    children[0] = new QuadTree(bounds.x - subWidth / 2, bounds.y - subHeight / 2, subWidth, subHeight, level + 1); // Top-left
-    children[1] = new QuadTree(bounds.x + subWidth / 2, bounds.y - subHeight / 2, subWidth, subHeight, level + 1); // Top-right
-    children[2] = new QuadTree(bounds.x - subWidth / 2, bounds.y + subHeight / 2, subWidth, subHeight, level + 1); // Bottom-left
-    children[3] = new QuadTree(bounds.x + subWidth / 2, bounds.y + subHeight / 2, subWidth, subHeight, level + 1); // Bottom-right
+// slot of the last entity in the node
+size_t QuadTree::lastSlot(int32_t index) const {
+    int32_t bucket = nodes[index].firstBucket;
+    while (bucketNext[bucket] != NONE) {
+        bucket = bucketNext[bucket];
+    }
+    return size_t(bucket) * BUCKET_SIZE + (nodes[index].count - 1) % BUCKET_SIZE;
 }
 
-QuadTree* QuadTree::insertIntoChildren(entt::entity entity, const entt::registry& registry) {
-    const auto& motion = registry.get<Motion>(entity);
+void QuadTree::writeSlot(size_t slot, entt::entity entity, const Box& box) {
+    payload[slot] = entity;
+    minX[slot] = box.minX;
+    minY[slot] = box.minY;
+    maxX[slot] = box.maxX;
+    maxY[slot] = box.maxY;
+}
 
-    // Create a quad from the hitbox
-    Quad entityQuad(motion.position.x, motion.position.y, motion.scale.x, motion.scale.y);
-    for (int i = 0; i < 4; ++i) {
-        if (children[i]->bounds.intersects(entityQuad)) {
-            return children[i]->insert(entity, registry);
+void QuadTree::pushObject(int32_t index, entt::entity entity, const Box& box) {
+    Node& node = nodes[index];
+    int32_t bucket = node.firstBucket;
+    if (node.count % BUCKET_SIZE == 0) {
+        int32_t fresh = allocateBucket();
+        if (bucket == NONE) {
+            node.firstBucket = fresh;
+        } else {
+            while (bucketNext[bucket] != NONE) {
+                bucket = bucketNext[bucket];
+            }
+            bucketNext[bucket] = fresh;
+        }
+        bucket = fresh;
+    } else {
+        while (bucketNext[bucket] != NONE) {
+            bucket = bucketNext[bucket];
         }
     }
-    return nullptr;
+    writeSlot(size_t(bucket) * BUCKET_SIZE + node.count % BUCKET_SIZE, entity, box);
+    node.count++;
+    locations[entity] = index;
 }
 
-bool QuadTree::remove(entt::entity entity, const entt::registry& registry) {
-    // If this node has children, try to remove from them first
-    if (children[0] != nullptr) {
-        const auto& motion = registry.get<Motion>(entity);
-
-        // Create a quad from the entity's position (using same approach as in insert)
-        Quad entityQuad(motion.position.x, motion.position.y, motion.scale.x, motion.scale.y);
-        //
-        // Try removing from each child that might contain the entity
-        for (int i = 0; i < 4; ++i) {
-            if (children[i]->bounds.intersects(entityQuad)) {
-                if (children[i]->remove(entity, registry)) {
-                    return true;
-                }
+// swap-with-last, the tail bucket goes back to the freelist once it's empty
+void QuadTree::eraseObject(int32_t index, entt::entity entity) {
+    size_t slot = findSlot(index, entity);
+    if (slot == SIZE_MAX) {
+        return;
+    }
+    size_t last = lastSlot(index);
+    writeSlot(slot, payload[last], Box{ minX[last], minY[last], maxX[last], maxY[last] });
+
+    Node& node = nodes[index];
+    node.count--;
+    if (node.count % BUCKET_SIZE == 0) {
+        int32_t tail = int32_t(last / BUCKET_SIZE);
+        if (node.firstBucket == tail) {
+            node.firstBucket = NONE;
+        } else {
+            int32_t previous = node.firstBucket;
+            while (bucketNext[previous] != tail) {
+                previous = bucketNext[previous];
             }
+            bucketNext[previous] = NONE;
         }
+        freeBuckets.push_back(tail);
     }
+}
 
-    // If not found in children or no children, try to remove from this node's objects
-    auto it = std::find(objects.begin(), objects.end(), entity);
-    if (it != objects.end()) {
-        objects.erase(it);
-        return true;
+// moves every entity of one node into another, releasing the source buckets as it goes
+void QuadTree::moveObjects(int32_t from, int32_t to) {
+    int32_t bucket = nodes[from].firstBucket;
+    uint32_t remaining = nodes[from].count;
+    nodes[from].firstBucket = NONE;
+    nodes[from].count = 0;
+    while (bucket != NONE) {
+        uint32_t n = std::min<uint32_t>(remaining, BUCKET_SIZE);
+        for (uint32_t i = 0; i < n; ++i) {
+            // index the pools on every push, pushObject may grow them
+            size_t slot = size_t(bucket) * BUCKET_SIZE + i;
+            pushObject(to, payload[slot], Box{ minX[slot], minY[slot], maxX[slot], maxY[slot] });
+        }
+        remaining -= n;
+        int32_t next = bucketNext[bucket];
+        freeBuckets.push_back(bucket);
+        bucket = next;
     }
-
-    return false; // Entity not found in this node or its children
 }
 
-std::vector<entt::entity> QuadTree::queryRange(const Quad& range, const entt::registry& registry) {
-    std::vector<entt::entity> results;
+void QuadTree::insert(entt::entity entity, const entt::registry& registry) {
+    insertAt(0, entity, entityBox(entity, registry));
+}
 
-    if (!bounds.intersects(range)) {
-        return results;
+// deepest existing node the box would be stored in, starting from index
+int32_t QuadTree::findHome(int32_t index, const Box& box) const {
+    while (nodes[index].firstChild != NONE) {
+        int32_t child = childFor(index, box);
+        if (child == NONE) {
+            break; // outside every child (at the root) or too big for it (loose), keep it here rather than losing it
+        }
+        index = child;
     }
-    // Add entities from this node
-    for (const auto& entity : objects) {
-        const auto& motion = registry.get<Motion>(entity);
-        Quad entityQuad(motion.position.x, motion.position.y, motion.scale.x, motion.scale.y);
+    return index;
+}
 
-        if (range.intersects(entityQuad)) {
-            results.push_back(entity);
+void QuadTree::insertAt(int32_t index, entt::entity entity, const Box& box) {
+    index = findHome(index, box);
+    pushObject(index, entity, box);
 
+    const Node& node = nodes[index];
+    if (node.firstChild == NONE && node.count > uint32_t(config.maxObjects) && node.level < config.maxLevels) {
+        split(index);
+    }
+}
 
+int32_t QuadTree::childFor(int32_t index, const Box& box) const {
+    int32_t first = nodes[index].firstChild;
+    if (isLoose()) {
+        // the quadrant holding the center, if the box fits in its grown bounds
+        Quad quad = nodeBounds(index);
+        int quadrant = int((box.minX + box.maxX) / 2.f >= quad.x) | (int((box.minY + box.maxY) / 2.f >= quad.y) << 1);
+        return fits(looseBounds(first + quadrant), box) ? first + quadrant : NONE;
+    }
+    for (int i = 0; i < 4; ++i) {
+        if (overlaps(nodeBounds(first + i), box)) {
+            return first + i;
         }
     }
+    return NONE;
+}
+
+void QuadTree::split(int32_t index) {
+    int32_t first;
+    if (!freeBlocks.empty()) {
+        first = freeBlocks.back();
+        freeBlocks.pop_back();
+    } else {
+        first = int32_t(nodes.size());
+        nodes.resize(nodes.size() + 4);
+    }
+    for (int i = 0; i < 4; ++i) {
+        Node& child = nodes[first + i];
+        child = Node();
+        child.parent = index;
+        child.level = nodes[index].level + 1;
+        child.code = (nodes[index].code << 2) | uint32_t(i); // bit 0 = right half, bit 1 = bottom half
+    }
+    nodes[index].firstChild = first;
 
-    // Add entities from children
-    if (children[0] != nullptr) {
-        for (int i = 0; i < 4; ++i) {
-            auto childResults = children[i]->queryRange(range, registry);
-            results.insert(results.end(), childResults.begin(), childResults.end());
+    // pull the objects out and push them back down; children can split in turn, so the scratch is used as a stack
+    size_t start = splitScratch.size();
+    uint32_t remaining = nodes[index].count;
+    for (int32_t bucket = nodes[index].firstBucket; bucket != NONE; bucket = bucketNext[bucket]) {
+        uint32_t n = std::min<uint32_t>(remaining, BUCKET_SIZE);
+        for (uint32_t i = 0; i < n; ++i) {
+            size_t slot = size_t(bucket) * BUCKET_SIZE + i;
+            splitScratch.push_back(payload[slot]);
+            splitScratchBoxes.push_back(Box{ minX[slot], minY[slot], maxX[slot], maxY[slot] });
         }
+        remaining -= n;
+        freeBuckets.push_back(bucket);
     }
+    nodes[index].firstBucket = NONE;
+    nodes[index].count = 0;
 
-    return results;
+    size_t end = splitScratch.size();
+    for (size_t i = start; i < end; ++i) {
+        insertAt(index, splitScratch[i], splitScratchBoxes[i]);
+    }
+    splitScratch.resize(start);
+    splitScratchBoxes.resize(start);
 }
 
+bool QuadTree::remove(entt::entity entity, const entt::registry& registry) {
+    auto location = locations.find(entity);
+    if (location == locations.end()) {
+        return false; // Entity not in the tree
+    }
+    int32_t index = location->second;
+    locations.erase(location);
+    eraseObject(index, entity);
+    tryMerge(index);
+    return true;
+}
 
-void QuadTree::clear() {
-    objects.clear();
+bool QuadTree::update(entt::entity entity, const entt::registry& registry) {
+    auto location = locations.find(entity);
+    if (location == locations.end()) {
+        return false;
+    }
+    int32_t index = location->second;
+    Box box = entityBox(entity, registry);
+    bool stays = isLoose() ? findHome(0, box) == index : nodes[index].firstChild == NONE && overlaps(nodeBounds(index), box);
+    if (stays) {
+        writeSlot(findSlot(index, entity), entity, box); // still belongs in the same node, just refresh the cached bounds
+        return true;
+    }
+    remove(entity, registry);
+    insert(entity, registry);
+    return true;
+}
 
+// stops counting once limit is exceeded, callers only care whether the subtree is small
+size_t QuadTree::countObjects(int32_t index, size_t limit) const {
+    const Node& node = nodes[index];
+    size_t count = node.count;
+    if (node.firstChild != NONE) {
+        for (int i = 0; i < 4 && count <= limit; ++i) {
+            count += countObjects(node.firstChild + i, limit - count);
+        }
+    }
+    return count;
+}
+
+// pulls every descendant's entities up into this node and hands the child block back to the pool
+void QuadTree::collapse(int32_t index) {
+    int32_t first = nodes[index].firstChild;
     for (int i = 0; i < 4; ++i) {
-        if (children[i] != nullptr) {
-            children[i]->clear();
-            delete children[i];
-            children[i] = nullptr;
+        if (nodes[first + i].firstChild != NONE) {
+            collapse(first + i);
         }
+        moveObjects(first + i, index);
     }
+    nodes[index].firstChild = NONE;
+    freeBlocks.push_back(first);
 }
 
+// Collapses the children back into their parent once they underflow. Merging at half capacity instead of
+// maxObjects keeps an entity bouncing across a border from splitting and merging every frame.
+void QuadTree::tryMerge(int32_t index) {
+    while (index != NONE) {
+        if (nodes[index].firstChild != NONE) {
+            size_t limit = size_t(config.maxObjects / 2);
+            if (countObjects(index, limit) > limit) {
+                return; // the parent holds at least as many, so it can't merge either
+            }
+            collapse(index);
+        }
+        index = nodes[index].parent;
+    }
+}
 
+std::vector<entt::entity> QuadTree::queryRange(const Quad& range, const entt::registry& registry) const {
+    std::vector<entt::entity> results;
+    queryRange(range, registry, results);
+    return results;
+}
 
+void QuadTree::queryRange(const Quad& range, const entt::registry& registry, std::vector<entt::entity>& out) const {
+    visitRange(range, registry, [&out](entt::entity entity) {
+        out.push_back(entity);
+        return true;
+    });
+}
+
+size_t QuadTree::countRange(const Quad& range, const entt::registry& registry) const {
+    size_t count = 0;
+    visitRange(range, registry, [&count](entt::entity) {
+        count++;
+        return true;
+    });
+    return count;
+}
+
+// keeps the pools' capacity around so rebuilding doesn't allocate again
+void QuadTree::clear() {
+    nodes.clear();
+    nodes.emplace_back();
+    freeBlocks.clear();
+    payload.clear();
+    minX.clear();
+    minY.clear();
+    maxX.clear();
+    maxY.clear();
+    bucketNext.clear();
+    freeBuckets.clear();
+    locations.clear();
+}
@@ -1,33 +1,233 @@
 #pragma once
 #include "quad.hpp"
+#include <unordered_map>
+#include <cstdint>
+#include <algorithm>
 
 
-// Hoping that quad-tree can be usable not just in collisions if we plan on further refactoring other systems, as the screen since 
-// it updates all entities that have motion within a certain distance of a player. 
-// MOBS and PROJECTILES are not in the quadtree, as mobs despawn and we dont have many of them, and projectiles are short lived and also
-// not many.
+// Hoping that quad-tree can be usable not just in collisions if we plan on further refactoring other systems, as the screen since
+// it updates all entities that have motion within a certain distance of a player.
+// MOBS and PROJECTILES are not in the quadtree, as mobs despawn and projectiles are short lived; they live in the
+// SpatialGrid (spatial_grid.hpp) instead, which is rebuilt every frame.
+// The tree is built once in initTree and then kept in sync incrementally: registry.patch<Motion>() re-buckets an entity
+// that left its node, and destroying an entity removes it (nodes merge back when they underflow).
+// Nodes live in one flat pool (no per-node allocations) and are linked by index, not by pointer. This is NOT a linear
+// quadtree: nodes aren't sorted or looked up by Morton key, only the four children of a node sit next to each other
+// in Z-order, and the Morton code stored on a node is just used to decode its bounds (with its level). Entities are
+// stored in fixed size buckets inside a single packed payload array. --quadtree-bench reports build allocations and
+// warm vs cold-cache query times for it.
+// Loose mode (looseness > 1): every node's bounds are grown by the looseness factor and objects are placed by their
+// center, going down as long as they fit inside the child's grown bounds. Each object then has exactly one home node
+// (possibly an inner one) and straddling objects are always found by queries.
+struct QuadTreeConfig {
+    int maxObjects = 15; // objects a leaf holds before it splits
+    int maxLevels = 5;
+    float looseness = 1.f;
+};
+
 class QuadTree{
 public:
-    static constexpr int MAX_OBJECTS = 15; 
-    static constexpr int MAX_LEVELS = 5;  
+    static constexpr int LEVEL_CAP = 15; // Morton codes are 32 bits, 2 bits per level
 
-    QuadTree(float x, float y, float width, float height, int level = 0)
-        : bounds(x, y, width, height), level(level) {
-        children.fill(nullptr);
-    }
-    
-    QuadTree* insert(entt::entity entity, const entt::registry& registry);
-    std::vector<entt::entity> queryRange(const Quad& range, const entt::registry& registry);
+    QuadTree(float x, float y, float width, float height, QuadTreeConfig config = QuadTreeConfig());
+    ~QuadTree();
+
+    QuadTree(const QuadTree&) = delete;
+    QuadTree& operator=(const QuadTree&) = delete;
+
+    void insert(entt::entity entity, const entt::registry& registry);
+    std::vector<entt::entity> queryRange(const Quad& range, const entt::registry& registry) const;
+    // appends into a caller owned buffer, so a reused buffer doesn't allocate once it has grown
+    void queryRange(const Quad& range, const entt::registry& registry, std::vector<entt::entity>& out) const;
+    size_t countRange(const Quad& range, const entt::registry& registry) const;
+    // calls visit(entity) for everything in range, returning false from visit stops the walk.
+    // Returns false if the walk was stopped early. Tests use the bounds cached at insert/update time.
+    template<typename Visitor>
+    bool visitRange(const Quad& range, const entt::registry& registry, Visitor&& visit) const;
+    // calls visit(entity, t) for everything whose bounds the segment origin + dir * t, t in [0, maxDist] passes through,
+    // t being where it enters. visit returns the maxDist to keep going with, so a closest-hit search can shrink it.
+    template<typename Visitor>
+    void visitSegment(vec2 origin, vec2 dir, float maxDist, Visitor&& visit) const;
     bool remove(entt::entity entity, const entt::registry& registry);
+    // re-buckets the entity only if it moved out of the node it is stored in
+    bool update(entt::entity entity, const entt::registry& registry);
+    bool contains(entt::entity entity) const { return locations.count(entity) > 0; }
     void clear();
     Quad bounds;
     void initTree(entt::registry& registry);
-    QuadTree* quadTree;
+    // rebuilds the tree if it was already built
+    void configure(const QuadTreeConfig& newConfig);
+    const QuadTreeConfig& getConfig() const { return config; }
 private:
-    int level;
-    std::vector<entt::entity> objects;
-    std::array<QuadTree*, 4> children;
+    static constexpr int BUCKET_SIZE = 16;
+    static constexpr int32_t NONE = -1;
+
+    QuadTreeConfig config;
+
+    struct Box {
+        float minX, minY, maxX, maxY;
+    };
 
-    void subdivide();
-    QuadTree* insertIntoChildren(entt::entity entity, const entt::registry& registry);
-};
\ No newline at end of file
+    struct Node {
+        int32_t firstChild = NONE; // children are firstChild..firstChild+3 (TL, TR, BL, BR)
+        int32_t parent = NONE;
+        int32_t firstBucket = NONE;
+        uint32_t count = 0;
+        uint32_t code = 0;         // Morton code of the cell at this level, 2 bits per level
+        uint8_t level = 0;
+    };
+
+    std::vector<Node> nodes;
+    std::vector<int32_t> freeBlocks;    // first index of released child blocks
+    std::vector<entt::entity> payload;  // BUCKET_SIZE slots per bucket
+    // bounds of each payload slot, split per side so the range test reads straight through them
+    std::vector<float> minX, minY, maxX, maxY;
+    std::vector<int32_t> bucketNext;
+    std::vector<int32_t> freeBuckets;
+    std::vector<entt::entity> splitScratch; // used as a stack, splits can nest
+    std::vector<Box> splitScratchBoxes;
+    // which node each entity lives in
+    std::unordered_map<entt::entity, int32_t> locations;
+    entt::registry* connectedRegistry = nullptr;
+
+    static Box entityBox(entt::entity entity, const entt::registry& registry);
+    // same strict test as Quad::intersects
+    static bool overlaps(const Quad& quad, const Box& box) {
+        return !(quad.x + quad.width / 2.f <= box.minX || quad.x - quad.width / 2.f >= box.maxX ||
+            quad.y + quad.height / 2.f <= box.minY || quad.y - quad.height / 2.f >= box.maxY);
+    }
+    static bool fits(const Quad& quad, const Box& box) {
+        return box.minX >= quad.x - quad.width / 2.f && box.maxX <= quad.x + quad.width / 2.f &&
+            box.minY >= quad.y - quad.height / 2.f && box.maxY <= quad.y + quad.height / 2.f;
+    }
+    // clips [t0, t1] to where the segment is between lo and hi on one axis
+    static bool slab(float lo, float hi, float origin, float dir, float& t0, float& t1) {
+        if (dir == 0.f) {
+            return origin >= lo && origin <= hi;
+        }
+        float a = (lo - origin) / dir;
+        float b = (hi - origin) / dir;
+        if (a > b) {
+            std::swap(a, b);
+        }
+        t0 = std::max(t0, a);
+        t1 = std::min(t1, b);
+        return t0 <= t1;
+    }
+    static bool segmentEnters(const Box& box, vec2 origin, vec2 dir, float maxDist, float& t) {
+        float t0 = 0.f, t1 = maxDist;
+        if (!slab(box.minX, box.maxX, origin.x, dir.x, t0, t1) || !slab(box.minY, box.maxY, origin.y, dir.y, t0, t1)) {
+            return false;
+        }
+        t = t0;
+        return true;
+    }
+    bool isLoose() const { return config.looseness > 1.f; }
+    Quad nodeBounds(int32_t index) const;
+    // what queries test against, the node bounds grown by the looseness
+    Quad looseBounds(int32_t index) const;
+    int32_t findHome(int32_t index, const Box& box) const;
+    void insertAt(int32_t index, entt::entity entity, const Box& box);
+    int32_t childFor(int32_t index, const Box& box) const;
+    void split(int32_t index);
+    void tryMerge(int32_t index);
+    void collapse(int32_t index);
+    size_t countObjects(int32_t index, size_t limit) const;
+
+    int32_t allocateBucket();
+    size_t findSlot(int32_t index, entt::entity entity) const;
+    size_t lastSlot(int32_t index) const;
+    void writeSlot(size_t slot, entt::entity entity, const Box& box);
+    void pushObject(int32_t index, entt::entity entity, const Box& box);
+    void eraseObject(int32_t index, entt::entity entity);
+    void moveObjects(int32_t from, int32_t to);
+
+    void connect(entt::registry& registry);
+    void disconnect();
+    void onMotionUpdate(entt::registry& registry, entt::entity entity);
+    void onMotionDestroy(entt::registry& registry, entt::entity entity);
+};
+
+template<typename Visitor>
+bool QuadTree::visitRange(const Quad& range, const entt::registry& registry, Visitor&& visit) const {
+    const float rangeMinX = range.x - range.width / 2.f;
+    const float rangeMaxX = range.x + range.width / 2.f;
+    const float rangeMinY = range.y - range.height / 2.f;
+    const float rangeMaxY = range.y + range.height / 2.f;
+
+    // depth first, children pushed in reverse so nodes are visited in the same order as a recursive walk
+    std::array<int32_t, 3 * LEVEL_CAP + 1> stack;
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        int32_t index = stack[--top];
+        const Node& node = nodes[index];
+        if (!looseBounds(index).intersects(range)) {
+            continue;
+        }
+
+        uint32_t remaining = node.count;
+        for (int32_t bucket = node.firstBucket; bucket != NONE; bucket = bucketNext[bucket]) {
+            uint32_t n = std::min<uint32_t>(remaining, BUCKET_SIZE);
+            size_t base = size_t(bucket) * BUCKET_SIZE;
+            const float* x0 = &minX[base];
+            const float* y0 = &minY[base];
+            const float* x1 = &maxX[base];
+            const float* y1 = &maxY[base];
+            // test the whole bucket first (no branches, vectorizes), then visit the hits
+            bool hit[BUCKET_SIZE];
+            for (uint32_t i = 0; i < n; ++i) {
+                hit[i] = (x1[i] > rangeMinX) & (x0[i] < rangeMaxX) & (y1[i] > rangeMinY) & (y0[i] < rangeMaxY);
+            }
+            for (uint32_t i = 0; i < n; ++i) {
+                if (hit[i] && !visit(payload[base + i])) {
+                    return false;
+                }
+            }
+            remaining -= n;
+        }
+
+        if (node.firstChild != NONE) {
+            for (int i = 3; i >= 0; --i) {
+                stack[top++] = node.firstChild + i;
+            }
+        }
+    }
+    return true;
+}
+
+template<typename Visitor>
+void QuadTree::visitSegment(vec2 origin, vec2 dir, float maxDist, Visitor&& visit) const {
+    std::array<int32_t, 3 * LEVEL_CAP + 1> stack;
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        int32_t index = stack[--top];
+        const Node& node = nodes[index];
+        Quad quad = looseBounds(index);
+        Box nodeBox{ quad.x - quad.width / 2.f, quad.y - quad.height / 2.f, quad.x + quad.width / 2.f, quad.y + quad.height / 2.f };
+        float t;
+        if (!segmentEnters(nodeBox, origin, dir, maxDist, t)) {
+            continue;
+        }
+
+        uint32_t remaining = node.count;
+        for (int32_t bucket = node.firstBucket; bucket != NONE; bucket = bucketNext[bucket]) {
+            uint32_t n = std::min<uint32_t>(remaining, BUCKET_SIZE);
+            size_t base = size_t(bucket) * BUCKET_SIZE;
+            for (uint32_t i = 0; i < n; ++i) {
+                Box box{ minX[base + i], minY[base + i], maxX[base + i], maxY[base + i] };
+                if (segmentEnters(box, origin, dir, maxDist, t)) {
+                    maxDist = visit(payload[base + i], t);
+                }
+            }
+            remaining -= n;
+        }
+
+        if (node.firstChild != NONE) {
+            for (int i = 3; i >= 0; --i) {
+                stack[top++] = node.firstChild + i;
+            }
+        }
+    }
+}
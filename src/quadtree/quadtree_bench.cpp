@@ -0,0 +1,125 @@
+#include "quadtree_bench.hpp"
+#include "quadtree.hpp"
+#include <map/map_system.hpp>
+#include <util/allocation_counter.hpp>
+#include <chrono>
+#include <cstdio>
+#include <random>
+
+namespace {
+using BenchClock = std::chrono::steady_clock;
+
+double msSince(BenchClock::time_point start) {
+    return std::chrono::duration<double, std::milli>(BenchClock::now() - start).count();
+}
+
+struct Measurement {
+    double ms = 0.0;
+    size_t allocations = 0;
+    size_t found = 0;
+};
+
+// runs query over every range and measures the lot
+template<typename Query>
+Measurement measure(const std::vector<Quad>& ranges, Query&& query) {
+    Measurement result;
+    size_t allocationsBefore = heapAllocationCount();
+    auto t0 = BenchClock::now();
+    for (const Quad& range : ranges) {
+        result.found += query(range);
+    }
+    result.ms = msSince(t0);
+    result.allocations = heapAllocationCount() - allocationsBefore;
+    return result;
+}
+}
+
+void runQuadTreeBenchmark(int queries, unsigned seed) {
+    if (MapSystem::map_width <= 0 || MapSystem::map_height <= 0) {
+        std::printf("quadtree bench: no map loaded\n");
+        return;
+    }
+    entt::registry registry;
+    vec2 playerSpawn, shipSpawn;
+    MapSystem::populate_ecs(registry, playerSpawn, shipSpawn);
+
+    const int mapWidth = MapSystem::map_width, mapHeight = MapSystem::map_height;
+    QuadTreeConfig config;
+    config.looseness = 2.f;
+    size_t buildAllocationsBefore = heapAllocationCount();
+    auto buildStart = BenchClock::now();
+    QuadTree quadTree((mapWidth / 2) * 16.f, (mapHeight / 2) * 16.f, (mapWidth + 32) * 16.f, (mapHeight + 32) * 16.f, config);
+    quadTree.initTree(registry);
+    double buildMs = msSince(buildStart);
+    size_t buildAllocations = heapAllocationCount() - buildAllocationsBefore;
+
+    // the same 1.25x window square render and collision ask for, centred anywhere on the map
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> xs(0.f, mapWidth * float(TILE_SIZE)), ys(0.f, mapHeight * float(TILE_SIZE));
+    const float side = WINDOW_WIDTH_PX * 1.25f;
+    std::vector<Quad> ranges;
+    ranges.reserve(queries);
+    for (int q = 0; q < queries; ++q) {
+        ranges.emplace_back(xs(rng), ys(rng), side, side);
+    }
+
+    Measurement vectors = measure(ranges, [&](const Quad& range) {
+        return quadTree.queryRange(range, registry).size();
+    });
+    std::vector<entt::entity> buffer;
+    Measurement buffered = measure(ranges, [&](const Quad& range) {
+        buffer.clear();
+        quadTree.queryRange(range, registry, buffer);
+        return buffer.size();
+    });
+    Measurement visited = measure(ranges, [&](const Quad& range) {
+        size_t count = 0;
+        quadTree.visitRange(range, registry, [&count](entt::entity) {
+            count++;
+            return true;
+        });
+        return count;
+    });
+    Measurement counted = measure(ranges, [&](const Quad& range) {
+        return quadTree.countRange(range, registry);
+    });
+    // No cache miss counters to read here, so instead sweep a buffer bigger than the LLC before every query: the
+    // cold - warm gap is what fetching the tree from memory costs, which is what the node pool is meant to cut
+    std::vector<char> sweep(32 << 20);
+    double sweepMs = 0.0;
+    Measurement cold = measure(ranges, [&](const Quad& range) {
+        auto sweepStart = BenchClock::now();
+        for (size_t i = 0; i < sweep.size(); i += 64) {
+            sweep[i]++;
+        }
+        sweepMs += msSince(sweepStart);
+        buffer.clear();
+        quadTree.queryRange(range, registry, buffer);
+        return buffer.size();
+    });
+    cold.ms -= sweepMs;
+
+    std::printf("quadtree bench: %zu objects in the tree, %d queries of %.0fx%.0f px\n",
+        registry.view<Motion, Hitbox>().size_hint(), queries, side, side);
+    if (!COUNTS_ALLOCATIONS) {
+        std::printf("quadtree bench: allocations not counted, configure with -DNOVA_COUNT_ALLOCATIONS=ON for them\n");
+    }
+    auto allocations = [](size_t count, int per) {
+        static char text[32];
+        if (!COUNTS_ALLOCATIONS) std::snprintf(text, sizeof(text), "n/a");
+        else if (per <= 1) std::snprintf(text, sizeof(text), "%zu", count);
+        else std::snprintf(text, sizeof(text), "%.1f", double(count) / per);
+        return text;
+    };
+    std::printf("quadtree bench: build %.3f ms, %s allocations\n", buildMs, allocations(buildAllocations, 1));
+    auto report = [&](const char* name, const Measurement& m) {
+        std::printf("quadtree bench: %-12s %.4f ms/query, %s allocations/query, %.1f found/query%s\n", name,
+            m.ms / std::max(queries, 1), allocations(m.allocations, queries), double(m.found) / std::max(queries, 1),
+            m.found == vectors.found ? "" : " (MISMATCH)");
+    };
+    report("queryRange", vectors);
+    report("buffer", buffered);
+    report("visitRange", visited);
+    report("countRange", counted);
+    report("buffer cold", cold);
+}
@@ -0,0 +1,7 @@
+#pragma once
+
+// Fills a fresh registry with the loaded map's trees and houses, builds the QuadTree the way main does and times
+// window sized queries (the rectangle render and collision use) through each query API: the vector returning
+// queryRange, the buffer overload, visitRange and countRange. Also counts the heap allocations each one makes.
+// Started with --quadtree-bench N from main.
+void runQuadTreeBenchmark(int queries, unsigned seed);
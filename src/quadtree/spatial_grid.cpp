@@ -0,0 +1,106 @@
+#include "spatial_grid.hpp"
+
+SpatialGrid::SpatialGrid(float x, float y, float width, float height, float cellSize)
+    : bounds(x, y, width, height), cellSize(cellSize) {
+    cols = std::max(1, int(std::ceil(width / cellSize)));
+    rows = std::max(1, int(std::ceil(height / cellSize)));
+    cellStart.assign(size_t(cols) * rows + 1, 0);
+}
+
+template<typename Tag>
+void SpatialGrid::gather(const entt::registry& registry) {
+    auto view = registry.view<Tag, Motion>();
+    for (auto entity : view) {
+        const auto& motion = view.template get<Motion>(entity);
+        float halfWidth = std::abs(motion.scale.x) / 2.f;
+        float halfHeight = std::abs(motion.scale.y) / 2.f;
+        maxHalfWidth = std::max(maxHalfWidth, halfWidth);
+        maxHalfHeight = std::max(maxHalfHeight, halfHeight);
+        unsorted.push_back(Entry{ entity, row(motion.position.y) * cols + column(motion.position.x),
+            motion.position.x - halfWidth, motion.position.y - halfHeight,
+            motion.position.x + halfWidth, motion.position.y + halfHeight });
+    }
+}
+
+void SpatialGrid::rebuild(const entt::registry& registry) {
+    unsorted.clear();
+    maxHalfWidth = 0.f;
+    maxHalfHeight = 0.f;
+    gather<Mob>(registry);
+    gather<Projectile>(registry);
+    gather<Slash>(registry);
+
+    // counting sort by cell
+    std::fill(cellStart.begin(), cellStart.end(), 0);
+    for (const auto& entry : unsorted) {
+        cellStart[entry.cell + 1]++;
+    }
+    for (size_t c = 1; c < cellStart.size(); ++c) {
+        cellStart[c] += cellStart[c - 1];
+    }
+    cursor.assign(cellStart.begin(), cellStart.end() - 1);
+    entries.resize(unsorted.size());
+    for (const auto& entry : unsorted) {
+        entries[cursor[entry.cell]++] = entry;
+    }
+}
+
+std::vector<entt::entity> SpatialGrid::queryRange(const Quad& range) const {
+    std::vector<entt::entity> results;
+    queryRange(range, results);
+    return results;
+}
+
+void SpatialGrid::queryRange(const Quad& range, std::vector<entt::entity>& out) const {
+    visitRange(range, [&out](entt::entity entity) {
+        out.push_back(entity);
+        return true;
+    });
+}
+
+size_t SpatialGrid::countRange(const Quad& range) const {
+    size_t count = 0;
+    visitRange(range, [&count](entt::entity) {
+        count++;
+        return true;
+    });
+    return count;
+}
+
+void SpatialGrid::kNearest(vec2 point, size_t k, float maxRadius, std::vector<entt::entity>& out) const {
+    if (k == 0) {
+        return;
+    }
+    // max-heap on distance holding the k best so far
+    auto& heap = nearestScratch;
+    heap.clear();
+    const float maxDistance = maxRadius * maxRadius;
+    int centerColumn = column(point.x);
+    int centerRow = row(point.y);
+    for (int ring = 0; ; ++ring) {
+        float bound = ringDistance(point, ring);
+        if (bound > maxRadius || (heap.size() == k && bound * bound >= heap.front().first)) {
+            break;
+        }
+        bool onGrid = visitRing(centerColumn, centerRow, ring, point, [&](const Entry& entry, float distance) {
+            if (distance > maxDistance) {
+                return;
+            }
+            if (heap.size() < k) {
+                heap.emplace_back(distance, entry.entity);
+                std::push_heap(heap.begin(), heap.end());
+            } else if (distance < heap.front().first) {
+                std::pop_heap(heap.begin(), heap.end());
+                heap.back() = { distance, entry.entity };
+                std::push_heap(heap.begin(), heap.end());
+            }
+        });
+        if (!onGrid) {
+            break;
+        }
+    }
+    std::sort_heap(heap.begin(), heap.end());
+    for (const auto& candidate : heap) {
+        out.push_back(candidate.second);
+    }
+}
@@ -0,0 +1,148 @@
+#pragma once
+#include "quad.hpp"
+#include <cstdint>
+#include <algorithm>
+#include <cmath>
+#include <cfloat>
+
+
+// Uniform grid for the things that move every frame and come and go a lot (mobs, projectiles, slashes), which is
+// what the quadtree deliberately leaves out. Rather than tracking moves it is rebuilt from scratch each frame with a
+// counting sort (O(n)), so entries of a cell sit next to each other. Each entity is filed under the cell holding its
+// center; queries are grown by the largest half size seen in the rebuild so nothing overlapping the range is missed.
+// Results are only as fresh as the last rebuild, so callers running after entities get destroyed should check
+// registry.valid().
+class SpatialGrid {
+public:
+    SpatialGrid(float x, float y, float width, float height, float cellSize);
+
+    void rebuild(const entt::registry& registry);
+
+    // same shape as the QuadTree queries
+    std::vector<entt::entity> queryRange(const Quad& range) const;
+    void queryRange(const Quad& range, std::vector<entt::entity>& out) const;
+    size_t countRange(const Quad& range) const;
+    template<typename Visitor>
+    bool visitRange(const Quad& range, Visitor&& visit) const;
+
+    // Nearest entity (by center) to point within maxRadius that accept(entity) is true for, entt::null if none.
+    // Cells are searched in rings around the point and the search stops once no further ring can be closer.
+    template<typename Predicate>
+    entt::entity nearest(vec2 point, Predicate&& accept, float maxRadius = FLT_MAX) const;
+    // up to k entities within maxRadius of point, closest first
+    void kNearest(vec2 point, size_t k, float maxRadius, std::vector<entt::entity>& out) const;
+
+    size_t size() const { return entries.size(); }
+    Quad bounds;
+private:
+    struct Entry {
+        entt::entity entity;
+        int32_t cell;
+        float minX, minY, maxX, maxY;
+    };
+
+    float cellSize;
+    int cols, rows;
+    float maxHalfWidth = 0.f, maxHalfHeight = 0.f;
+
+    std::vector<Entry> entries;     // sorted by cell
+    std::vector<int32_t> cellStart; // entries of cell c are [cellStart[c], cellStart[c + 1])
+    std::vector<Entry> unsorted;    // scratch for the rebuild
+    std::vector<int32_t> cursor;
+
+    int column(float x) const {
+        return std::clamp(int(std::floor((x - (bounds.x - bounds.width / 2.f)) / cellSize)), 0, cols - 1);
+    }
+    int row(float y) const {
+        return std::clamp(int(std::floor((y - (bounds.y - bounds.height / 2.f)) / cellSize)), 0, rows - 1);
+    }
+
+    template<typename Tag>
+    void gather(const entt::registry& registry);
+
+    // calls visit(entry, squared distance) for every entry in cells at Chebyshev distance ring from the point's cell.
+    // Returns false once the ring is entirely off the grid.
+    template<typename Visitor>
+    bool visitRing(int centerColumn, int centerRow, int ring, vec2 point, Visitor&& visit) const;
+    // nothing in a ring can be closer than this (no bound for points off the grid, their cell is clamped)
+    float ringDistance(vec2 point, int ring) const {
+        return bounds.contains(point.x, point.y) ? std::max(0, ring - 1) * cellSize : 0.f;
+    }
+    mutable std::vector<std::pair<float, entt::entity>> nearestScratch;
+};
+
+template<typename Visitor>
+bool SpatialGrid::visitRange(const Quad& range, Visitor&& visit) const {
+    const float rangeMinX = range.x - range.width / 2.f;
+    const float rangeMaxX = range.x + range.width / 2.f;
+    const float rangeMinY = range.y - range.height / 2.f;
+    const float rangeMaxY = range.y + range.height / 2.f;
+
+    int c0 = column(rangeMinX - maxHalfWidth);
+    int c1 = column(rangeMaxX + maxHalfWidth);
+    int r0 = row(rangeMinY - maxHalfHeight);
+    int r1 = row(rangeMaxY + maxHalfHeight);
+    for (int r = r0; r <= r1; ++r) {
+        for (int c = c0; c <= c1; ++c) {
+            int cell = r * cols + c;
+            for (int32_t i = cellStart[cell]; i < cellStart[cell + 1]; ++i) {
+                const Entry& entry = entries[i];
+                if (entry.maxX > rangeMinX && entry.minX < rangeMaxX && entry.maxY > rangeMinY && entry.minY < rangeMaxY &&
+                    !visit(entry.entity)) {
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+template<typename Visitor>
+bool SpatialGrid::visitRing(int centerColumn, int centerRow, int ring, vec2 point, Visitor&& visit) const {
+    int c0 = centerColumn - ring, c1 = centerColumn + ring;
+    int r0 = centerRow - ring, r1 = centerRow + ring;
+    if (c0 < 0 && r0 < 0 && c1 >= cols && r1 >= rows) {
+        return false;
+    }
+    for (int r = std::max(r0, 0); r <= std::min(r1, rows - 1); ++r) {
+        // inner rows only have the two end cells in this ring
+        int step = (r == r0 || r == r1) ? 1 : c1 - c0;
+        for (int c = c0; c <= c1; c += std::max(step, 1)) {
+            if (c < 0 || c >= cols) {
+                continue;
+            }
+            int cell = r * cols + c;
+            for (int32_t i = cellStart[cell]; i < cellStart[cell + 1]; ++i) {
+                const Entry& entry = entries[i];
+                float dx = (entry.minX + entry.maxX) / 2.f - point.x;
+                float dy = (entry.minY + entry.maxY) / 2.f - point.y;
+                visit(entry, dx * dx + dy * dy);
+            }
+        }
+    }
+    return true;
+}
+
+template<typename Predicate>
+entt::entity SpatialGrid::nearest(vec2 point, Predicate&& accept, float maxRadius) const {
+    entt::entity best = entt::null;
+    float bestDistance = maxRadius * maxRadius;
+    int centerColumn = column(point.x);
+    int centerRow = row(point.y);
+    for (int ring = 0; ; ++ring) {
+        float bound = ringDistance(point, ring);
+        if (bound > maxRadius || (best != entt::null && bound * bound >= bestDistance)) {
+            break;
+        }
+        bool onGrid = visitRing(centerColumn, centerRow, ring, point, [&](const Entry& entry, float distance) {
+            if (distance <= bestDistance && (best == entt::null || distance < bestDistance) && accept(entry.entity)) {
+                best = entry.entity;
+                bestDistance = distance;
+            }
+        });
+        if (!onGrid) {
+            break;
+        }
+    }
+    return best;
+}
@@ -19,9 +19,10 @@
 
 
 
-RenderSystem::RenderSystem(entt::registry& reg, QuadTree& quadTree):
+RenderSystem::RenderSystem(entt::registry& reg, QuadTree& quadTree, SpatialGrid& dynamicGrid):
 	registry(reg), 
-	quadTree(quadTree)
+	quadTree(quadTree),
+	dynamicGrid(dynamicGrid)
 
 {
 	// screen_state_entity = registry.create();
@@ -460,7 +461,7 @@ void RenderSystem::drawDebugHitBoxes(const glm::mat3& projection) {
 
 		// Convert hitbox points to vertices
 		std::vector<float> vertices;
-		for (const auto& pt : hitbox.pts) {
+		for (const auto& pt : hitbox.pts()) {
 			vertices.push_back(pt.x);
 			vertices.push_back(pt.y);
 		}
@@ -471,7 +472,7 @@ void RenderSystem::drawDebugHitBoxes(const glm::mat3& projection) {
 		glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
 
 		// Draw the hitbox as a line loop
-		glDrawArrays(GL_LINE_LOOP, 0, hitbox.pts.size());
+		glDrawArrays(GL_LINE_LOOP, 0, hitbox.pts().size());
 
 		// Clean up
 		glBindBuffer(GL_ARRAY_BUFFER, 0);
@@ -734,20 +735,16 @@ void RenderSystem::renderGamePlay()
 		queryRange
 	);
 
-	std::vector<entt::entity> nearbyEntities = quadTree.quadTree->queryRange(rangeQuad, registry);
+	nearbyEntities.clear();
+	quadTree.queryRange(rangeQuad, registry, nearbyEntities);
 	nearbyEntities.push_back(playerEntity); // never have to update player since all queries will be based off player anyways
-	auto mobs = registry.view<Mob>();
-	for (auto mob : mobs) {
-		nearbyEntities.push_back(mob);
-	}
-	auto projectiles = registry.view<Projectile>();
-	for (auto projectile : projectiles) {
-		nearbyEntities.push_back(projectile);
-	}
-	auto slashes = registry.view<Slash>(); 
-	for (auto slash : slashes) {
-		nearbyEntities.push_back(slash); 
-	}
+	// the grid was built before collisions, skip anything destroyed since
+	dynamicGrid.visitRange(rangeQuad, [&](entt::entity entity) {
+		if (registry.valid(entity)) {
+			nearbyEntities.push_back(entity);
+		}
+		return true;
+	});
 
 
 	// render all the ship weapons/engine
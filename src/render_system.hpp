@@ -6,6 +6,7 @@
 #include "common.hpp"
 #include "tinyECS/components.hpp"
 #include "quadtree/quadtree.hpp"
+#include "quadtree/spatial_grid.hpp"
 #include "render/shader.h"
 
 // System responsible for setting up OpenGL and for rendering all the
@@ -131,7 +132,7 @@ class RenderSystem {
 	};
 
 public:
-	RenderSystem(entt::registry& reg, QuadTree& quadTree);
+	RenderSystem(entt::registry& reg, QuadTree& quadTree, SpatialGrid& dynamicGrid);
 
 
 	// Initialize the window
@@ -167,6 +168,8 @@ public:
 private:
 	entt::registry& registry;
 	QuadTree& quadTree;
+	SpatialGrid& dynamicGrid;
+	std::vector<entt::entity> nearbyEntities; // reused every frame so the query doesn't allocate
 	// Internal drawing functions for each entity type
 	void drawTexturedMesh(entt::entity entity, const mat3& projection);
 	void drawToScreen(bool vignette);
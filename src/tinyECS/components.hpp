@@ -15,11 +15,23 @@ enum class ColliderType {
 	CREATURE,
 	PROJECTILE,
 	OBSTACLE,
+	SLASH,
+	COUNT
 }; 
 
 struct Glyph{};
 struct Tree{};
 struct Background{};
+// things that move each tick (by velocity or by following something); the only Motions physics integrates
+struct Dynamic{};
+// activity levels set by the ActivitySystem for things away from the player, no tag means active
+struct LowFrequency {
+	uint8_t phase = 0; // which tick of the cycle it runs on
+	bool due = false;  // runs this tick
+};
+struct Asleep {
+	bool dynamic = false; // had the Dynamic tag, given back on waking
+};
 
 struct Boss{
 	float agro_range;
@@ -37,6 +37,15 @@ void UISystem::updateMobHealthBar(entt::registry& registry, entt::entity& mob_en
 	}
 }
 
+void UISystem::updateMobHealthBars(entt::registry& registry) {
+	for (auto&& [entity, healthbar, motion] : registry.view<MobHealthBar, Motion>().each()) {
+		if (!registry.valid(healthbar.entity) || !registry.all_of<Motion>(healthbar.entity)) {
+			continue;
+		}
+		motion.position = computeHealthBarPosition(registry.get<Motion>(healthbar.entity), { healthbar.left_adjust, healthbar.y_adjust });
+	}
+}
+
 void UISystem::useItem(entt::registry& registry, entt::entity& inventory_slot_entity, float mouse_pos_x, float mouse_pos_y) {
 	auto& inventory_slot = registry.get<InventorySlot>(inventory_slot_entity);
 	auto& entity = inventory_slot.item;
@@ -10,6 +10,8 @@ public:
 	static float equip_delay;
 	static void updatePlayerHealthBar(entt::registry& registry, int currMaxHealth, int health);
 	static void updateMobHealthBar(entt::registry& registry, entt::entity& mob_entity, bool hit);
+	// moves every mob health bar to its mob, one pass over the bars
+	static void updateMobHealthBars(entt::registry& registry);
 	//static void renderItem(entt::registry& registry, entt::entity& mob_entity);
 	static void equipItem(entt::registry& registry, Motion& player_motion, FlagSystem& flag_system);
 	static void addToInventory(entt::registry& registry, entt::entity& item_entity, FlagSystem& flag_system);
@@ -0,0 +1,49 @@
+#include "allocation_counter.hpp"
+
+#ifdef NOVA_COUNT_ALLOCATIONS
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+// Has to replace the global operator new to see the allocations inside the library containers. Kept in its own file
+// so the replacements aren't inlined into the code being measured.
+static std::atomic<size_t> heapAllocations{ 0 };
+
+void* operator new(std::size_t size) {
+    heapAllocations.fetch_add(1, std::memory_order_relaxed);
+    // same as the standard one: keep asking the new handler until it frees something or gives up
+    while (true) {
+        if (void* p = std::malloc(size ? size : 1)) {
+            return p;
+        }
+        std::new_handler handler = std::get_new_handler();
+        if (!handler) {
+            throw std::bad_alloc();
+        }
+        handler();
+    }
+}
+void* operator new[](std::size_t size) {
+    return operator new(size);
+}
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+void operator delete[](void* p) noexcept {
+    std::free(p);
+}
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+void operator delete[](void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+size_t heapAllocationCount() {
+    return heapAllocations.load(std::memory_order_relaxed);
+}
+#else
+size_t heapAllocationCount() {
+    return 0;
+}
+#endif
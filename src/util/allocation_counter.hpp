@@ -0,0 +1,13 @@
+#pragma once
+#include <cstddef>
+
+// Heap allocations made through operator new since the program started, for the benchmarks. Only counted in builds
+// configured with NOVA_COUNT_ALLOCATIONS (allocation_counter.cpp then replaces the global operator new, which costs
+// every allocation an atomic add); otherwise always 0.
+#ifdef NOVA_COUNT_ALLOCATIONS
+constexpr bool COUNTS_ALLOCATIONS = true;
+#else
+constexpr bool COUNTS_ALLOCATIONS = false;
+#endif
+
+size_t heapAllocationCount();
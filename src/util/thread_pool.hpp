@@ -0,0 +1,82 @@
+#pragma once
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <vector>
+#include <algorithm>
+
+// Fixed set of threads for splitting one job into lanes. run(job) calls job(lane) once for every lane in
+// [0, size()) and returns when all are done; lane 0 runs on the calling thread, so a pool of 1 spawns nothing.
+class ThreadPool {
+public:
+    explicit ThreadPool(size_t lanes) {
+        lanes = std::max<size_t>(lanes, 1);
+        for (size_t lane = 1; lane < lanes; ++lane) {
+            workers.emplace_back([this, lane]() { work(lane); });
+        }
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    size_t size() const { return workers.size() + 1; }
+
+    void run(const std::function<void(size_t)>& job) {
+        if (workers.empty()) {
+            job(0);
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            current = &job;
+            pending = workers.size();
+            generation++;
+        }
+        wake.notify_all();
+        job(0);
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this]() { return pending == 0; });
+        current = nullptr;
+    }
+
+private:
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake, done;
+    const std::function<void(size_t)>* current = nullptr;
+    size_t pending = 0;
+    size_t generation = 0;
+    bool stopping = false;
+
+    void work(size_t lane) {
+        size_t seen = 0;
+        while (true) {
+            const std::function<void(size_t)>* job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [&]() { return stopping || generation != seen; });
+                if (stopping) return;
+                seen = generation;
+                job = current;
+            }
+            (*job)(lane);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                pending--;
+            }
+            done.notify_one();
+        }
+    }
+};
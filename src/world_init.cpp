@@ -31,6 +31,7 @@ entt::entity createPlayer(entt::registry& registry, vec2 position)
 	sprite.sheet_dims = PLAYER_SPRITESHEET.sheet_dims;
 
 	auto& player = registry.emplace<Player>(entity);
+	registry.emplace<Dynamic>(entity);
 	player.health = PLAYER_HEALTH;
 	player.currMaxHealth = PLAYER_HEALTH;
 	player.maxHealth = PLAYER_MAX_HEALTH;
@@ -55,10 +56,10 @@ entt::entity createPlayer(entt::registry& registry, vec2 position)
 	float w = motion.scale.x;
 	float h = motion.scale.y;
 	auto& hitbox = registry.emplace<Hitbox>(entity);
-	hitbox.pts = {
+	hitbox.shape = intern_shape({
 		{w * -0.5f, h * -0.5f}, {w * 0.5f, h * -0.5f},
 		{w * 0.5f, h * 0.5f},   {w * -0.5f, h * 0.5f}
-	};
+	});
 	hitbox.depth = 50; // TODO: change this back to unset (epsilon)
 	hitbox.type = ColliderType::PLAYER;
 
@@ -120,6 +121,7 @@ entt::entity createSlash(entt::registry& registry) {
    auto entity = registry.create();  
 
    Slash& slash = registry.emplace<Slash>(entity);  
+   registry.emplace<Dynamic>(entity);
    auto player = registry.view<Player>().front();
 
    auto motion_player = registry.get<Motion>(player); 
@@ -177,17 +179,19 @@ entt::entity createSlash(entt::registry& registry) {
    }
 
    auto& hitbox = registry.emplace<Hitbox>(entity);
+   hitbox.type = ColliderType::SLASH;
 
    
    const int numPoints = 16; 
-   hitbox.pts.clear();
+   std::vector<vec2> pts;
 
    for (int i = 0; i < numPoints; i++) {
 	   float angle = 2.0f * M_PI * i / numPoints;
 	   float x = radius * cos(angle);
 	   float y = radius * sin(angle);
-	   hitbox.pts.push_back({ x, y });
+	   pts.push_back({ x, y });
    }
+   hitbox.shape = intern_shape(pts);
    hitbox.depth = 100;
    
   /* hitbox.pts = {
@@ -222,6 +226,7 @@ entt::entity createMobHealthBar(entt::registry& registry, entt::entity& mob_enti
 
 	registry.emplace<UI>(entity);
 	registry.emplace<MobHealthBar>(entity);
+	registry.emplace<Dynamic>(entity);
 	auto& healthbar = registry.get<MobHealthBar>(entity);
 
 	auto& mob = registry.get<Mob>(mob_entity);
@@ -272,10 +277,10 @@ entt::entity createShip(entt::registry& registry, vec2 position)
 	float w = motion.scale.x * 0.5;
 	float h = motion.scale.y * 0.3;
 	auto& hitbox = registry.emplace<Hitbox>(entity);
-	hitbox.pts = {
+	hitbox.shape = intern_shape({
 		{w * -0.45f, h * -0.9f}, {w * 0.45f, h * -0.9f},
 		{w * 0.45f, h * 0.15f},   {w * -0.45f, h * 0.15f}
-	};
+	});
 	hitbox.depth = 130;
 	hitbox.type = ColliderType::OBSTACLE;
 
@@ -507,6 +512,7 @@ entt::entity createProjectile(entt::registry& registry, vec2 pos, vec2 size, vec
 	}
 
 	auto& projectile = registry.emplace<Projectile>(entity);
+	registry.emplace<Dynamic>(entity);
 	projectile.damage = damage;
 	projectile.timer = timer;
 	projectile.targetTypes = targetTypes;
@@ -521,12 +527,12 @@ entt::entity createProjectile(entt::registry& registry, vec2 pos, vec2 size, vec
 	float w = motion.scale.x;
 	float h = motion.scale.y;
 	auto& hitbox = registry.emplace<Hitbox>(entity);
-	hitbox.pts = {
+	hitbox.shape = intern_shape({
 		{w * -0.25f, h * -0.50f}, {w *  0.25f, h * -0.50f}, // Top pts
 		{w *  0.50f, h * -0.25f}, {w *  0.50f, h *  0.25f}, // Right pts
 		{w *  0.25f, h *  0.50f}, {w * -0.25f, h *  0.50f}, // Bot pts
 		{w * -0.50f, h *  0.25f}, {w * -0.50f, h * -0.25f}, // Left pts
-	};
+	});
 	hitbox.type = ColliderType::PROJECTILE;
 
 	auto& renderRequest = registry.emplace<RenderRequest>(entity);
@@ -623,10 +629,10 @@ void setTreeType(
 	}
 
 	// hitbox is relative to object's center
-	hitbox.pts = {
+	hitbox.shape = intern_shape({
 		{w * -0.5f, g + h * -0.5f}, {w * 0.5f, g + h * -0.5f},
 		{w * 0.5f, g + h * 0.5f},   {w * -0.5f, g + h * 0.5f}
-	};
+	});
 }
 
 entt::entity createTree(entt::registry& registry, vec2 pos, Biome biome, Terrain terrain) {
@@ -688,11 +694,12 @@ entt::entity createHouse(entt::registry& registry, vec2 pos, Biome biome) {
 
 	auto& hitbox = registry.emplace<Hitbox>(entity);
 	float h = motion.scale.y, g = 0.f;
-	hitbox.pts = {
+	hitbox.shape = intern_shape({
 		{w * -0.5f, g + h * -0.5f}, {w * 0.5f, g + h * -0.5f},
 		{w * 0.5f, g + h * 0.5f},   {w * -0.5f, g + h * 0.5f}
-	};
+	});
 	hitbox.depth = depth;
+	hitbox.type = ColliderType::OBSTACLE;
 
 	auto& renderRequest = registry.emplace<RenderRequest>(entity);
 	renderRequest.used_texture = TEXTURE_ASSET_ID::HOUSE;
@@ -812,20 +819,18 @@ entt::entity createShotgunWeapon(entt::registry& registry) {
 	return shotgun_entity;
 }
 
-void findNearestTarget(entt::registry& registry, entt::entity& entity, float x, float y) {
-	float radius = 10.0f;
-	while (radius <= WINDOW_WIDTH_PX / 2) {
-		bool found = false;
-		for (auto mob_entity : registry.view<Mob>()) {
-			auto& motion = registry.get<Motion>(mob_entity);
-			if (abs(motion.position.x - x) <= radius && abs(motion.position.y - y) <= radius) {
-				registry.emplace<HomingMissile>(entity).target = mob_entity;
-				found = true;
-				break;
-			}
+// closest mob within half a screen (square) of (x, y)
+void findNearestTarget(entt::registry& registry, const SpatialGrid& dynamicGrid, entt::entity& entity, float x, float y) {
+	const float radius = WINDOW_WIDTH_PX / 2;
+	entt::entity target = dynamicGrid.nearest(vec2(x, y), [&](entt::entity candidate) {
+		if (!registry.valid(candidate) || !registry.all_of<Mob>(candidate)) {
+			return false;
 		}
-		if (found) break;
-		radius += 10.f;
+		auto& motion = registry.get<Motion>(candidate);
+		return abs(motion.position.x - x) <= radius && abs(motion.position.y - y) <= radius;
+	}, radius * sqrt(2.f));
+	if (target != entt::null) {
+		registry.emplace<HomingMissile>(entity).target = target;
 	}
 }
 
@@ -855,6 +860,7 @@ entt::entity createCreature(entt::registry& registry, vec2 position, const Creat
 	auto entity = registry.create();
 
 	auto& mob = registry.emplace<Mob>(entity);
+	registry.emplace<Dynamic>(entity);
 	mob.health = health;
 	mob.hit_time = 1.f;
 
@@ -887,7 +893,7 @@ entt::entity createCreature(entt::registry& registry, vec2 position, const Creat
 	motion.offset_to_ground = def.getPhysicsInfo().offset_to_ground;
 
 	auto& hitbox = registry.emplace<Hitbox>(entity);
-	hitbox.pts = def.getPhysicsInfo().hitbox.pts;
+	hitbox.shape = def.getPhysicsInfo().hitbox.shape;
 	hitbox.depth = def.getPhysicsInfo().hitbox.depth;
 	hitbox.type = ColliderType::CREATURE;
 
@@ -73,4 +73,4 @@ entt::entity createDefaultWeapon(entt::registry& registry);
 entt::entity createHomingMissleWeapon(entt::registry& registry);
 entt::entity createShotgunWeapon(entt::registry& registry);
 
-void findNearestTarget(entt::registry& registry, entt::entity& entity, float x, float y);
\ No newline at end of file
+void findNearestTarget(entt::registry& registry, const SpatialGrid& dynamicGrid, entt::entity& entity, float x, float y);
\ No newline at end of file
@@ -15,9 +15,10 @@
 #include <glm/glm.hpp>
 
 // create the world
-WorldSystem::WorldSystem(entt::registry& reg, PhysicsSystem& physics_system, FlagSystem& flag_system, QuadTree& quadTree) :
+WorldSystem::WorldSystem(entt::registry& reg, PhysicsSystem& physics_system, FlagSystem& flag_system, QuadTree& quadTree, SpatialGrid& dynamicGrid) :
 	registry(reg),
 	quadTree(quadTree),
+	dynamicGrid(dynamicGrid),
 	physics_system(physics_system),
 	flag_system(flag_system)
 {
@@ -343,17 +344,20 @@ bool WorldSystem::step(float elapsed_ms_since_last_update) {
 
 	// TODO: check if ENEMY is within the range of the ship, and have it shoot towards that direction
 	// auto &ship = registry.get<Ship>(ship_entity);
-	auto mobs = registry.view<Mob>();
-
 	float elapsed_s = elapsed_ms_since_last_update / 1000;
 	ship.timer -= elapsed_s;
 
 	if (ship.timer <= 0) {
 		ship.timer = SHIP_TIMER_S;
 		
-		for (auto entity : mobs) {
+		// only the grid cells around the ship instead of every mob on the map
+		auto shipMotion = registry.get<Motion>(ship_entity);
+		Quad shipRange(shipMotion.position.x, shipMotion.position.y, 2 * ship.range, 2 * ship.range);
+		dynamicGrid.visitRange(shipRange, [&](entt::entity entity) {
+			if (!registry.valid(entity) || !registry.all_of<Mob>(entity)) {
+				return true;
+			}
 			auto motion = registry.get<Motion>(entity);
-			auto shipMotion = registry.get<Motion>(ship_entity);
 
 			glm::vec2 shipPos = glm::vec2(shipMotion.position.x, shipMotion.position.y);
 			glm::vec2 enemyPos = glm::vec2(motion.position.x, motion.position.y);
@@ -386,7 +390,8 @@ bool WorldSystem::step(float elapsed_ms_since_last_update) {
 						break;
 				}
 			}
-		}
+			return true;
+		});
 	}
 
 
@@ -1553,7 +1558,7 @@ void WorldSystem::left_mouse_click() {
 			auto& player_pos = registry.get<Motion>(*registry.view<Player>().begin()).position;
 			float x = mouse_pos_x - WINDOW_WIDTH_PX / 2 + player_pos.x;
 			float y = mouse_pos_y - WINDOW_HEIGHT_PX / 2 + player_pos.y;
-			findNearestTarget(registry, missile_entity, x, y);
+			findNearestTarget(registry, dynamicGrid, missile_entity, x, y);
 			player_comp.homing_missle_weapon_cooldown_dynamic = player_comp.homing_missle_weapon_cooldown;
 			MusicSystem::playSoundEffect(SFX::MISSILE);
 		}
@@ -20,7 +20,7 @@ class WorldSystem
 {
 public:
 
-	WorldSystem(entt::registry& reg, PhysicsSystem& physics_system, FlagSystem& flag_system, QuadTree& quadTree);
+	WorldSystem(entt::registry& reg, PhysicsSystem& physics_system, FlagSystem& flag_system, QuadTree& quadTree, SpatialGrid& dynamicGrid);
 
 	// creates main window
 	GLFWwindow* create_window();
@@ -51,6 +51,7 @@ private:
 	entt::registry& registry;
 	entt::entity player_entity;
 	QuadTree& quadTree; 
+	SpatialGrid& dynamicGrid;
 	PhysicsSystem& physics_system;
 	FlagSystem& flag_system;
 